@@ -0,0 +1,83 @@
+// Accuracy versus speed of the Barnes-Hut solver against direct summation, for a
+// uniform disk of bodies over a range of body counts and opening angles.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_util.h"
+#include "core/barneshut.h"
+#include "core/gravity.h"
+
+static int CompareDoubles(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double TimeDirect(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count, ForceReal* ax, ForceReal* ay)
+{
+    const double start = GetClockSeconds();
+    ComputeAccelerations(px, py, mass, count, ax, ay, NULL);
+    return GetClockSeconds() - start;
+}
+
+int main(void)
+{
+    static const int counts[] = { 1024, 4096, 16384, 65536 };
+    static const ForceReal thetas[] = { 0.3f, 0.5f, 0.7f, 1.0f };
+
+    printf("%-8s %-6s %12s %12s %9s %12s %12s\n", "bodies", "theta", "direct ms", "tree ms", "speedup", "median err", "p99 err");
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        const int count = counts[c];
+        ForceReal* px = malloc(count * sizeof(ForceReal));
+        ForceReal* py = malloc(count * sizeof(ForceReal));
+        ForceReal* mass = malloc(count * sizeof(ForceReal));
+        ForceReal* refX = malloc(count * sizeof(ForceReal));
+        ForceReal* refY = malloc(count * sizeof(ForceReal));
+        ForceReal* ax = malloc(count * sizeof(ForceReal));
+        ForceReal* ay = malloc(count * sizeof(ForceReal));
+        double* errors = malloc(count * sizeof(double));
+        if (!px || !py || !mass || !refX || !refY || !ax || !ay || !errors) return 1;
+
+        srand(4321);
+        for (int i = 0; i < count; i++) {
+            const float radius = 1000.0f * sqrtf(RandomRange(0.0f, 1.0f));
+            const float angle = RandomRange(0.0f, 6.2831853f);
+            px[i] = radius * cosf(angle);
+            py[i] = radius * sinf(angle);
+            mass[i] = RandomRange(1.0f, 10.0f);
+        }
+
+        const double directSeconds = TimeDirect(px, py, mass, count, refX, refY);
+        QuadTree tree = { 0 };
+
+        for (size_t t = 0; t < sizeof(thetas) / sizeof(thetas[0]); t++) {
+            ComputeAccelerationsBarnesHut(&tree, px, py, mass, count, thetas[t], ax, ay, NULL); // Warm up the node pool
+
+            int iterations = 0;
+            const double start = GetClockSeconds();
+            do {
+                ComputeAccelerationsBarnesHut(&tree, px, py, mass, count, thetas[t], ax, ay, NULL);
+                iterations++;
+            } while (GetClockSeconds() - start < 0.25);
+            const double treeSeconds = (GetClockSeconds() - start) / iterations;
+
+            for (int i = 0; i < count; i++) {
+                const double reference = hypot(refX[i], refY[i]);
+                errors[i] = hypot(ax[i] - refX[i], ay[i] - refY[i]) / (reference > 0.0 ? reference : 1.0);
+            }
+
+            qsort(errors, count, sizeof(double), CompareDoubles);
+
+            printf("%-8d %-6.2f %12.2f %12.2f %8.1fx %12.2e %12.2e\n", count, thetas[t], directSeconds * 1e3,
+                   treeSeconds * 1e3, directSeconds / treeSeconds, errors[count / 2], errors[count * 99 / 100]);
+        }
+
+        UnloadQuadTree(tree);
+        free(px); free(py); free(mass); free(refX); free(refY); free(ax); free(ay); free(errors);
+    }
+
+    return 0;
+}
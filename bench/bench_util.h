@@ -0,0 +1,13 @@
+#ifndef GABRK_BENCH_UTIL_H
+#define GABRK_BENCH_UTIL_H
+
+#include <stdlib.h>
+
+#include "core/clock.h"
+
+static inline float RandomRange(float min, float max)
+{
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+#endif
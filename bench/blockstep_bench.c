@@ -0,0 +1,151 @@
+// A rotating disk of light bodies with a few tight, heavy binaries: the binaries orbit
+// about a hundred times faster than the disk turns. A global-step method has to take the
+// binaries' step for every body; block time steps give only the binaries short steps.
+// Both runs cover the same time and report body forces (bodies whose acceleration was
+// summed, each over every body), wall time and relative energy error.
+//
+//   blockstep_bench [--count 512] [--binaries 8] [--time 50] [--method RK4] [--dt 0.015625]
+//                   [--block-dt 4] [--levels 12] [--eta 0.01] [--threads -1]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/blockstep.h"
+#include "core/bodies.h"
+#include "core/gravity.h"
+#include "core/threadpool.h"
+
+#define DISK_RADIUS 500.0f
+#define BINARY_MASS 20.0f
+#define BINARY_SEPARATION 2.0f
+
+// The first 2 * binaries bodies are the binaries' members, the rest the disk
+static void InitCluster(BodySystem* system, int binaries)
+{
+    const int count = system->count;
+    const float diskMass = (float)(count - 2 * binaries) + 2.0f * binaries * BINARY_MASS;
+    srand(4242);
+
+    for (int i = 0; i < count; i++) {
+        const float radius = DISK_RADIUS * sqrtf(RandomRange(0.0f, 1.0f));
+        const float angle = RandomRange(0.0f, 6.2831853f);
+        const float speed = sqrtf(GRAVITY_G * diskMass * radius) / DISK_RADIUS; // Circular in a uniform disk
+        system->px[i] = radius * cosf(angle);
+        system->py[i] = radius * sinf(angle);
+        system->vx[i] = -speed * sinf(angle);
+        system->vy[i] = speed * cosf(angle);
+        system->mass[i] = 1.0f;
+    }
+
+    // Each binary replaces two disk bodies by a circular pair around the first one's place
+    for (int b = 0; b < binaries; b++) {
+        const int i = 2 * b, j = 2 * b + 1;
+        const float angle = RandomRange(0.0f, 6.2831853f);
+        const float d = BINARY_SEPARATION;
+        const float eps2 = GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+        const float orbitalSpeed = sqrtf(GRAVITY_G * 2.0f * BINARY_MASS * d * d / powf(d * d + eps2, 1.5f)) / 2.0f;
+        const float cx = (float)system->px[i], cy = (float)system->py[i];
+        const float cvx = (float)system->vx[i], cvy = (float)system->vy[i];
+
+        system->px[i] = cx + 0.5f * d * cosf(angle);
+        system->py[i] = cy + 0.5f * d * sinf(angle);
+        system->px[j] = cx - 0.5f * d * cosf(angle);
+        system->py[j] = cy - 0.5f * d * sinf(angle);
+        system->vx[i] = cvx - orbitalSpeed * sinf(angle);
+        system->vy[i] = cvy + orbitalSpeed * cosf(angle);
+        system->vx[j] = cvx + orbitalSpeed * sinf(angle);
+        system->vy[j] = cvy - orbitalSpeed * cosf(angle);
+        system->mass[i] = BINARY_MASS;
+        system->mass[j] = BINARY_MASS;
+    }
+    system->accelerationsValid = 0;
+}
+
+static double TotalEnergy(const BodySystem* system)
+{
+    return ComputeKineticEnergy(system) + ComputePotentialEnergy(system);
+}
+
+static void PrintRun(const char* name, long long bodyForces, double seconds, double energyError, long long reference)
+{
+    printf("%-22s %14lld %10.1fx %10.3f %12.3e\n", name, bodyForces, (double)reference / (double)bodyForces, seconds,
+           energyError);
+}
+
+int main(int argc, char** argv)
+{
+    int count = 512;
+    int binaries = 8;
+    double duration = 50.0;
+    int method = RK4;
+    double dt = 0.015625;   // About 200 steps per binary orbit
+    double blockDt = 4.0;
+    int levels = 12;
+    double eta = 0.01; // About the global run's energy error
+    int threads = -1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--count") == 0) count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--binaries") == 0) binaries = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--time") == 0) duration = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--method") == 0) method = FindMethod(argv[i + 1]);
+        else if (strcmp(argv[i], "--dt") == 0) dt = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--block-dt") == 0) blockDt = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--levels") == 0) levels = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--eta") == 0) eta = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (method < 0 || count < 2 || binaries < 0 || 2 * binaries > count || dt <= 0.0 || blockDt <= 0.0) {
+        fprintf(stderr, "Invalid method, body count, binaries or step\n");
+        return 1;
+    }
+
+    ThreadPool* pool = (threads >= 0) ? CreateThreadPool(threads) : NULL;
+    BodySystem system = LoadBodySystem(count);
+    BlockStepper stepper = LoadBlockStepper(count, levels, (Real)eta);
+    if (system.count == 0 || stepper.count == 0) return 1;
+    system.pool = pool;
+
+    printf("bodies=%d binaries=%d time=%g threads=%d precision=%s\n", count, binaries, duration, GetThreadPoolSize(pool),
+           GABRK_PRECISION_NAME);
+    printf("%-22s %14s %11s %10s %12s\n", "integrator", "body forces", "saving", "seconds", "energy error");
+
+    InitCluster(&system, binaries);
+    double initialEnergy = TotalEnergy(&system);
+    const long steps = (long)ceil(duration / dt);
+    double start = GetClockSeconds();
+    for (long s = 0; s < steps; s++) StepBodySystem(&system, (Method)method, (Real)dt);
+    const double globalSeconds = GetClockSeconds() - start;
+    const long long globalForces = system.forceEvaluations * count;
+    char name[64];
+    snprintf(name, sizeof(name), "%s dt=%g", GetMethodName(method), dt);
+    PrintRun(name, globalForces, globalSeconds, fabs(TotalEnergy(&system) / initialEnergy - 1.0), globalForces);
+
+    InitCluster(&system, binaries);
+    initialEnergy = TotalEnergy(&system);
+    const long blockSteps = (long)ceil(duration / blockDt);
+    start = GetClockSeconds();
+    for (long s = 0; s < blockSteps; s++) StepBodySystemBlock(&system, &stepper, (Real)blockDt);
+    const double blockSeconds = GetClockSeconds() - start;
+    snprintf(name, sizeof(name), "Hermite block dt=%g", blockDt);
+    PrintRun(name, stepper.bodyForces, blockSeconds, fabs(TotalEnergy(&system) / initialEnergy - 1.0), globalForces);
+
+    printf("\nlevel  step         bodies\n");
+    for (int level = 0; level <= stepper.maxLevel; level++) {
+        int bodies = 0;
+        for (int i = 0; i < count; i++) bodies += stepper.levels[i] == level;
+        if (bodies > 0) printf("%5d  %-12g %6d\n", level, blockDt / ldexp(1.0, level), bodies);
+    }
+    printf("%lld block steps\n", stepper.blockSteps);
+
+    UnloadBlockStepper(stepper);
+    UnloadBodySystem(system);
+    DestroyThreadPool(pool);
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Cost of the cell-list cutoff solver at fixed density: the disk grows with the body
+// count, so every body keeps about the same number of partners within the cutoff and the
+// time per body should stay flat, while all-pairs summation grows linearly per body.
+// The cell-list result is checked against a brute-force sum of the same shifted pairs.
+//
+//   cutoff_bench [--cutoff 50] [--density 0.001]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/cellgrid.h"
+#include "core/gravity.h"
+
+#define MAX_DIRECT_COUNT 65536 // All-pairs timing gets too slow beyond this
+#define MAX_CHECKED_COUNT 16384
+
+// Brute-force reference of EvaluateCutoffRange in double, from the pair potential's gradient
+static double CheckBody(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count, int i, double cutoff,
+                        const ForceReal* ax, const ForceReal* ay)
+{
+    const double eps2 = (double)GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+    const double cutoffInvDistance = 1.0 / sqrt(cutoff * cutoff + eps2);
+    const double forceShift = cutoff * cutoffInvDistance * cutoffInvDistance * cutoffInvDistance;
+
+    double sumX = 0.0, sumY = 0.0, magnitude = 0.0;
+    for (int j = 0; j < count; j++) {
+        const double dx = (double)px[j] - px[i];
+        const double dy = (double)py[j] - py[i];
+        const double distanceSquared = dx * dx + dy * dy;
+        if (j == i || distanceSquared >= cutoff * cutoff) continue;
+
+        const double invDistance = 1.0 / sqrt(distanceSquared + eps2);
+        const double shift = (distanceSquared > 0.0) ? forceShift / sqrt(distanceSquared) : 0.0;
+        const double scale = GRAVITY_G * mass[j] * (invDistance * invDistance * invDistance - shift);
+        sumX += dx * scale;
+        sumY += dy * scale;
+        magnitude += fabs(scale) * sqrt(distanceSquared);
+    }
+    return hypot(ax[i] - sumX, ay[i] - sumY) / (magnitude > 0.0 ? magnitude : 1.0);
+}
+
+int main(int argc, char** argv)
+{
+    static const int counts[] = { 1024, 4096, 16384, 65536, 262144 };
+    double cutoff = 50.0;
+    double density = 0.001; // Bodies per unit area, about 8 partners within the default cutoff
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--cutoff") == 0) cutoff = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--density") == 0) density = atof(argv[i + 1]);
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!(cutoff > 0.0) || !(density > 0.0)) {
+        fprintf(stderr, "--cutoff and --density must be positive\n");
+        return 1;
+    }
+
+    printf("cutoff=%g density=%g (%.1f partners per body)\n", cutoff, density, density * 3.14159265 * cutoff * cutoff);
+    printf("%-8s %12s %12s %12s %12s %12s %12s\n", "bodies", "direct ms", "direct ns/b", "cells ms", "cells ns/b",
+           "build ms", "max err");
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        const int count = counts[c];
+        ForceReal* px = malloc(count * sizeof(ForceReal));
+        ForceReal* py = malloc(count * sizeof(ForceReal));
+        ForceReal* mass = malloc(count * sizeof(ForceReal));
+        ForceReal* ax = malloc(count * sizeof(ForceReal));
+        ForceReal* ay = malloc(count * sizeof(ForceReal));
+        if (!px || !py || !mass || !ax || !ay) return 1;
+
+        srand(2718);
+        const float diskRadius = (float)sqrt(count / (3.14159265 * density));
+        for (int i = 0; i < count; i++) {
+            const float radius = diskRadius * sqrtf(RandomRange(0.0f, 1.0f));
+            const float angle = RandomRange(0.0f, 6.2831853f);
+            px[i] = radius * cosf(angle);
+            py[i] = radius * sinf(angle);
+            mass[i] = RandomRange(1.0f, 10.0f);
+        }
+
+        double directSeconds = NAN;
+        if (count <= MAX_DIRECT_COUNT) {
+            const double start = GetClockSeconds();
+            ComputeAccelerations(px, py, mass, count, ax, ay, NULL);
+            directSeconds = GetClockSeconds() - start;
+        }
+
+        CellGrid grid = LoadCellGrid(count);
+        if (!grid.cellStart) return 1;
+        ComputeAccelerationsCutoff(&grid, px, py, mass, count, (ForceReal)cutoff, ax, ay, NULL); // Warm up the caches
+
+        int iterations = 0;
+        double buildSeconds = 0.0;
+        const double start = GetClockSeconds();
+        do {
+            const double buildStart = GetClockSeconds();
+            BuildCellGrid(&grid, px, py, mass, count, (ForceReal)cutoff);
+            buildSeconds += GetClockSeconds() - buildStart;
+            EvaluateCutoffRange(&grid, 0, count, (ForceReal)cutoff, ax, ay, NULL);
+            iterations++;
+        } while (GetClockSeconds() - start < 0.25);
+        const double cellSeconds = (GetClockSeconds() - start) / iterations;
+
+        double maxError = NAN;
+        if (count <= MAX_CHECKED_COUNT) {
+            maxError = 0.0;
+            for (int i = 0; i < count; i += 7) maxError = fmax(maxError, CheckBody(px, py, mass, count, i, cutoff, ax, ay));
+        }
+
+        printf("%-8d %12.2f %12.1f %12.3f %12.1f %12.3f %12.2e\n", count, directSeconds * 1e3, directSeconds * 1e9 / count,
+               cellSeconds * 1e3, cellSeconds * 1e9 / count, buildSeconds / iterations * 1e3, maxError);
+
+        UnloadCellGrid(grid);
+        free(px); free(py); free(mass); free(ax); free(ay);
+    }
+
+    return 0;
+}
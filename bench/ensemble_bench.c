@@ -0,0 +1,132 @@
+// Steps a sweep of independent two-body systems (varied masses, separations and launch
+// speeds) as one ensemble, and compares the throughput with stepping the same systems
+// one BodySystem at a time. Per-system energies can be written as CSV.
+//
+//   ensemble_bench [--count 65536] [--steps 1000] [--dt 60] [--method RK4] [--threads N]
+//                  [--out FILE]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/bodies.h"
+#include "core/ensemble.h"
+#include "core/threadpool.h"
+
+#define SEQUENTIAL_SAMPLE 256 // Systems stepped one at a time for the baseline
+
+static BinarySystem SweepSystem(int index)
+{
+    srand(7919u * (unsigned)index + 1u);
+    const ForceReal m1 = RandomRange(1.0f, 20.0f);
+    const ForceReal m2 = RandomRange(1.0f, 20.0f);
+    const Real separation = RandomRange(100.0f, 400.0f);
+    const Real speedScale = RandomRange(0.8f, 1.1f);
+    return MakeBinaryOrbit(m1, m2, separation, speedScale);
+}
+
+static int CompareDoubles(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv)
+{
+    int count = 65536;
+    long steps = 1000;
+    double dt = 60.0;
+    int method = RK4;
+    int threads = 0;
+    const char* outPath = NULL;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--count") == 0) count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--steps") == 0) steps = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--dt") == 0) dt = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--method") == 0) method = FindMethod(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--out") == 0) outPath = argv[i + 1];
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (method < 0 || count <= 0 || steps <= 0) {
+        fprintf(stderr, "Invalid method, count or steps\n");
+        return 1;
+    }
+
+    ThreadPool* pool = CreateThreadPool(threads);
+    Ensemble ensemble = LoadEnsemble(count, pool);
+    double* initialEnergies = malloc(count * sizeof(double));
+    double* finalEnergies = malloc(count * sizeof(double));
+    double* drifts = malloc(count * sizeof(double));
+    if (!pool || ensemble.count == 0 || !initialEnergies || !finalEnergies || !drifts) return 1;
+
+    for (int i = 0; i < count; i++) SetEnsembleSystem(&ensemble, i, SweepSystem(i));
+    ComputeEnsembleEnergies(&ensemble, initialEnergies);
+
+    double start = GetClockSeconds();
+    for (long s = 0; s < steps; s++) StepEnsemble(&ensemble, (Method)method, (Real)dt);
+    const double ensembleSeconds = GetClockSeconds() - start;
+
+    ComputeEnsembleEnergies(&ensemble, finalEnergies);
+
+    // Baseline: the same systems as separate two-body BodySystems on one thread
+    const int sample = (count < SEQUENTIAL_SAMPLE) ? count : SEQUENTIAL_SAMPLE;
+    BodySystem system = LoadBodySystem(2);
+    if (system.count == 0) return 1;
+
+    start = GetClockSeconds();
+    for (int i = 0; i < sample; i++) {
+        const BinarySystem binary = SweepSystem(i);
+        system.px[0] = binary.x1; system.py[0] = binary.y1; system.vx[0] = binary.vx1; system.vy[0] = binary.vy1;
+        system.px[1] = binary.x2; system.py[1] = binary.y2; system.vx[1] = binary.vx2; system.vy[1] = binary.vy2;
+        system.mass[0] = binary.m1;
+        system.mass[1] = binary.m2;
+        system.accelerationsValid = 0;
+        for (long s = 0; s < steps; s++) StepBodySystem(&system, (Method)method, (Real)dt);
+    }
+    const double sequentialSeconds = (GetClockSeconds() - start) * count / sample;
+    UnloadBodySystem(system);
+
+    for (int i = 0; i < count; i++) {
+        drifts[i] = fabs((finalEnergies[i] - initialEnergies[i]) / initialEnergies[i]);
+    }
+
+    if (outPath) {
+        FILE* out = fopen(outPath, "w");
+        if (!out) {
+            fprintf(stderr, "Cannot open %s\n", outPath);
+            return 1;
+        }
+        fprintf(out, "system,m1,m2,initial_energy,final_energy,energy_drift\n");
+        for (int i = 0; i < count; i++) {
+            const BinarySystem binary = GetEnsembleSystem(&ensemble, i);
+            fprintf(out, "%d,%g,%g,%.17g,%.17g,%.6e\n", i, (double)binary.m1, (double)binary.m2, initialEnergies[i],
+                    finalEnergies[i], drifts[i]);
+        }
+        fclose(out);
+    }
+
+    qsort(drifts, count, sizeof(double), CompareDoubles);
+
+    const double systemSteps = (double)count * steps;
+    printf("method=%s systems=%d steps=%ld dt=%g threads=%d\n", GetMethodName((Method)method), count, steps, dt,
+           GetThreadPoolSize(pool));
+    printf("ensemble:   %10.3f s %14.1f Msystem-steps/s\n", ensembleSeconds, systemSteps / ensembleSeconds * 1e-6);
+    printf("sequential: %10.3f s %14.1f Msystem-steps/s (extrapolated from %d systems, one thread)\n", sequentialSeconds,
+           systemSteps / sequentialSeconds * 1e-6, sample);
+    printf("speedup=%.1fx energy drift median=%.3e p99=%.3e max=%.3e\n", sequentialSeconds / ensembleSeconds,
+           drifts[count / 2], drifts[(int)(count * 0.99)], drifts[count - 1]);
+
+    free(initialEnergies);
+    free(finalEnergies);
+    free(drifts);
+    UnloadEnsemble(ensemble);
+    DestroyThreadPool(pool);
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Microbenchmark for the pairwise gravity kernels: pair interactions per second for
+// every kernel the CPU supports, relative to the scalar kernel.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_util.h"
+#include "core/gravity.h"
+
+int main(void)
+{
+    static const int counts[] = { 256, 1024, 4096, 16384 };
+    const double minSeconds = 0.25;
+
+    printf("%-8s %-8s %14s %10s %12s\n", "bodies", "kernel", "Mpairs/s", "speedup", "max rel err");
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        const int count = counts[c];
+        ForceReal* px = malloc(count * sizeof(ForceReal));
+        ForceReal* py = malloc(count * sizeof(ForceReal));
+        ForceReal* mass = malloc(count * sizeof(ForceReal));
+        ForceReal* refX = malloc(count * sizeof(ForceReal));
+        ForceReal* refY = malloc(count * sizeof(ForceReal));
+        ForceReal* ax = malloc(count * sizeof(ForceReal));
+        ForceReal* ay = malloc(count * sizeof(ForceReal));
+        if (!px || !py || !mass || !refX || !refY || !ax || !ay) return 1;
+
+        srand(1234);
+        for (int i = 0; i < count; i++) {
+            px[i] = RandomRange(0.0f, 1000.0f);
+            py[i] = RandomRange(0.0f, 1000.0f);
+            mass[i] = RandomRange(1.0f, 10.0f);
+        }
+
+        SetGravityKernel(GRAVITY_KERNEL_SCALAR);
+        ComputeAccelerations(px, py, mass, count, refX, refY, NULL);
+
+        const double pairs = 0.5 * (double)count * (double)(count - 1);
+        double scalarRate = 0.0;
+
+        for (int kernel = 0; kernel < GRAVITY_KERNEL_COUNT; kernel++) {
+            if (!IsGravityKernelSupported((GravityKernel)kernel)) continue;
+            SetGravityKernel((GravityKernel)kernel);
+
+            int iterations = 0;
+            const double start = GetClockSeconds();
+            double elapsed = 0.0;
+            do {
+                ComputeAccelerations(px, py, mass, count, ax, ay, NULL);
+                iterations++;
+                elapsed = GetClockSeconds() - start;
+            } while (elapsed < minSeconds);
+
+            double maxError = 0.0;
+            for (int i = 0; i < count; i++) {
+                const double reference = hypot(refX[i], refY[i]);
+                const double error = hypot(ax[i] - refX[i], ay[i] - refY[i]) / (reference > 0.0 ? reference : 1.0);
+                if (error > maxError) maxError = error;
+            }
+
+            const double rate = pairs * iterations / elapsed;
+            if (kernel == GRAVITY_KERNEL_SCALAR) scalarRate = rate;
+
+            printf("%-8d %-8s %14.1f %9.2fx %12.2e\n", count, gravityKernelNames[kernel], rate * 1e-6, rate / scalarRate, maxError);
+        }
+
+        free(px); free(py); free(mass); free(refX); free(refY); free(ax); free(ay);
+    }
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Sweeps every integrator over a range of time steps and body counts and reports wall
+// time per step, force evaluations per step and relative energy drift as CSV or JSON
+// (absolute drift when the initial energy is 0, as for a single body).
+//
+// Embedded methods are also run under the adaptive controller for each tolerance in
+// --rtols; those rows report the mean accepted dt.
+//
+//   integrator_bench [--format csv|json] [--out FILE] [--counts 2,256]
+//                    [--dts 5,15,60,120] [--rtols 1e-4,1e-5,1e-6] [--horizon 40000] [--threads N]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/bodies.h"
+#include "core/gravity.h"
+#include "core/rk.h"
+#include "core/threadpool.h"
+
+#define MAX_SWEEP 16
+#define ENERGY_SAMPLES 16
+
+typedef struct {
+    int counts[MAX_SWEEP];
+    int countCount;
+    float dts[MAX_SWEEP];
+    int dtCount;
+    float rtols[MAX_SWEEP];
+    int rtolCount;
+    double horizon;
+    int threads;
+    int json;
+    const char* outPath;
+} Options;
+
+typedef struct {
+    Method method;
+    int adaptive;
+    float rtol;
+    int bodies;
+    float dt;
+    long steps;
+    double seconds;
+    long long forceEvaluations;
+    double forceEvaluationsPerStep;
+    double energyDrift;
+    double maxEnergyDrift;
+} Result;
+
+static int ParseList(const char* text, float* values, int capacity)
+{
+    int count = 0;
+    while (*text && count < capacity) {
+        char* end = NULL;
+        values[count++] = strtof(text, &end);
+        if (end == text) return count - 1;
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+// Two-body orbit for two bodies, otherwise light bodies on circular orbits around a
+// central mass so that the energy stays dominated by well-defined orbits.
+static void InitScenario(BodySystem* system)
+{
+    if (system->count == 2) {
+        ResetTwoBodyOrbit(system);
+        return;
+    }
+
+    const float centralMass = 20.0f;
+    system->px[0] = 400.0f; system->py[0] = 300.0f;
+    system->vx[0] = 0.0f; system->vy[0] = 0.0f;
+    system->mass[0] = centralMass;
+
+    srand(2024);
+    for (int i = 1; i < system->count; i++) {
+        const float radius = RandomRange(100.0f, 300.0f);
+        const float angle = RandomRange(0.0f, 6.2831853f);
+        const float speed = sqrtf(GRAVITY_G * centralMass / radius);
+        system->px[i] = 400.0f + radius * cosf(angle);
+        system->py[i] = 300.0f + radius * sinf(angle);
+        system->vx[i] = -speed * sinf(angle);
+        system->vy[i] = speed * cosf(angle);
+        system->mass[i] = 1e-4f;
+    }
+    system->accelerationsValid = 0;
+}
+
+static double TotalEnergy(const BodySystem* system)
+{
+    return ComputeKineticEnergy(system) + ComputePotentialEnergy(system);
+}
+
+// rtol > 0 runs the adaptive controller with the given tolerance, starting from dt
+static Result RunCase(BodySystem* system, Method method, float dt, float rtol, double horizon)
+{
+    Result result = { method, rtol > 0.0f, rtol, system->count, dt, 0, 0.0, 0, 0.0, 0.0, 0.0 };
+    const double sampleInterval = horizon / ENERGY_SAMPLES;
+    const long stepsPerSample = (long)ceil(sampleInterval / dt);
+    AdaptiveController controller = CreateAdaptiveController(dt, rtol, rtol);
+
+    InitScenario(system);
+    system->forceEvaluations = 0;
+    const double initialEnergy = TotalEnergy(system);
+
+    for (int sample = 0; sample < ENERGY_SAMPLES; sample++) {
+        const double start = GetClockSeconds();
+        if (result.adaptive) {
+            result.steps += AdvanceBodySystemAdaptive(system, method, &controller, (Real)sampleInterval);
+        }
+        else {
+            for (long s = 0; s < stepsPerSample; s++) StepBodySystem(system, method, dt);
+            result.steps += stepsPerSample;
+        }
+        result.seconds += GetClockSeconds() - start;
+
+        const double change = TotalEnergy(system) - initialEnergy;
+        const double drift = fabs((initialEnergy != 0.0) ? change / initialEnergy : change);
+        if (drift > result.maxEnergyDrift || isnan(drift)) result.maxEnergyDrift = drift;
+        result.energyDrift = drift;
+    }
+
+    if (result.adaptive) result.dt = (float)(horizon / result.steps);
+    result.forceEvaluations = system->forceEvaluations;
+    result.forceEvaluationsPerStep = (double)system->forceEvaluations / result.steps;
+    return result;
+}
+
+static void WriteResult(FILE* out, const Result* result, int json, int first)
+{
+    const double nsPerStep = result->seconds * 1e9 / result->steps;
+
+    if (json) {
+        fprintf(out, "%s  {\"method\": \"%s\", \"mode\": \"%s\", \"rtol\": %g, \"bodies\": %d, \"dt\": %g, \"steps\": %ld, "
+                     "\"seconds\": %.6f, \"ns_per_step\": %.1f, \"force_evals\": %lld, \"force_evals_per_step\": %.2f, "
+                     "\"energy_drift\": %.6e, \"max_energy_drift\": %.6e}",
+                first ? "" : ",\n", GetMethodName(result->method), result->adaptive ? "adaptive" : "fixed", result->rtol,
+                result->bodies, result->dt, result->steps, result->seconds, nsPerStep, result->forceEvaluations,
+                result->forceEvaluationsPerStep, result->energyDrift, result->maxEnergyDrift);
+    }
+    else {
+        fprintf(out, "%s,%s,%g,%d,%g,%ld,%.6f,%.1f,%lld,%.2f,%.6e,%.6e\n", GetMethodName(result->method),
+                result->adaptive ? "adaptive" : "fixed", result->rtol, result->bodies, result->dt, result->steps, result->seconds,
+                nsPerStep, result->forceEvaluations, result->forceEvaluationsPerStep, result->energyDrift, result->maxEnergyDrift);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options = { { 2, 256 }, 2, { 5.0f, 15.0f, 60.0f, 120.0f }, 4, { 1e-4f, 1e-5f, 1e-6f }, 3, 40000.0, -1, 0, NULL };
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--format") == 0) options.json = strcmp(argv[i + 1], "json") == 0;
+        else if (strcmp(argv[i], "--out") == 0) options.outPath = argv[i + 1];
+        else if (strcmp(argv[i], "--horizon") == 0) options.horizon = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0) options.threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--dts") == 0) options.dtCount = ParseList(argv[i + 1], options.dts, MAX_SWEEP);
+        else if (strcmp(argv[i], "--rtols") == 0) options.rtolCount = ParseList(argv[i + 1], options.rtols, MAX_SWEEP);
+        else if (strcmp(argv[i], "--counts") == 0) {
+            float counts[MAX_SWEEP];
+            options.countCount = ParseList(argv[i + 1], counts, MAX_SWEEP);
+            for (int c = 0; c < options.countCount; c++) options.counts[c] = (int)counts[c];
+        }
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    FILE* out = options.outPath ? fopen(options.outPath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot open %s\n", options.outPath);
+        return 1;
+    }
+
+    ThreadPool* pool = (options.threads >= 0) ? CreateThreadPool(options.threads) : NULL;
+
+    if (options.json) fprintf(out, "[\n");
+    else fprintf(out, "method,mode,rtol,bodies,dt,steps,seconds,ns_per_step,force_evals,force_evals_per_step,energy_drift,max_energy_drift\n");
+
+    int first = 1;
+    for (int c = 0; c < options.countCount; c++) {
+        BodySystem system = LoadBodySystem(options.counts[c]);
+        if (system.count == 0) continue;
+        system.pool = pool;
+
+        for (int d = 0; d < options.dtCount; d++) {
+            for (int method = 0; method < METHOD_COUNT; method++) {
+                const Result result = RunCase(&system, (Method)method, options.dts[d], 0.0f, options.horizon);
+                WriteResult(out, &result, options.json, first);
+                first = 0;
+                fflush(out);
+            }
+        }
+
+        for (int r = 0; r < options.rtolCount; r++) {
+            for (int method = 0; method < METHOD_COUNT; method++) {
+                if (!IsEmbeddedMethod((Method)method)) continue;
+                const Result result = RunCase(&system, (Method)method, options.dts[0], options.rtols[r], options.horizon);
+                WriteResult(out, &result, options.json, first);
+                fflush(out);
+            }
+        }
+
+        system.pool = NULL;
+        UnloadBodySystem(system);
+    }
+
+    if (options.json) fprintf(out, "\n]\n");
+    if (out != stdout) fclose(out);
+    DestroyThreadPool(pool);
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Integrates the viewer's two-body orbit over five periods, once serially with the fine
+// method and once with Parareal across the pool, and compares wall time and the
+// deviation of the Parareal result from the serial one. The critical-path speedup is the
+// one a machine with a core per slice would see, whatever this one has.
+//
+//   parareal_bench [--steps 2000000] [--dt 0.01] [--method RK4] [--coarse RK4] [--coarse-steps 1000]
+//                  [--slices 0] [--threads 0] [--tolerance 1e-4 (float) or 1e-9] [--iterations 0]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/bodies.h"
+#include "core/parareal.h"
+#include "core/threadpool.h"
+
+int main(int argc, char** argv)
+{
+    long steps = 2000000;
+    double dt = 0.01;
+    int fineMethod = RK4;
+    int coarseMethod = RK4;
+    int coarseSteps = 1000;
+    int slices = 0;
+    int threads = 0;
+    double tolerance = (sizeof(Real) == sizeof(float)) ? 1e-4 : 1e-9; // Float boundaries stall at the rounding of the fine run
+    int iterations = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--steps") == 0) steps = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--dt") == 0) dt = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--method") == 0) fineMethod = FindMethod(argv[i + 1]);
+        else if (strcmp(argv[i], "--coarse") == 0) coarseMethod = FindMethod(argv[i + 1]);
+        else if (strcmp(argv[i], "--coarse-steps") == 0) coarseSteps = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--slices") == 0) slices = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--tolerance") == 0) tolerance = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--iterations") == 0) iterations = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (fineMethod < 0 || coarseMethod < 0 || steps <= 0 || coarseSteps <= 0) {
+        fprintf(stderr, "Invalid method, steps or coarse steps\n");
+        return 1;
+    }
+
+    ThreadPool* pool = CreateThreadPool(threads);
+    BodySystem serial = LoadBodySystem(2);
+    BodySystem parallel = LoadBodySystem(2);
+    PararealSolver solver = LoadPararealSolver(2, slices, pool);
+    if (!pool || serial.count == 0 || parallel.count == 0 || solver.sliceCount == 0) return 1;
+
+    ResetTwoBodyOrbit(&serial);
+    ResetTwoBodyOrbit(&parallel);
+
+    double start = GetClockSeconds();
+    for (long s = 0; s < steps; s++) StepBodySystem(&serial, (Method)fineMethod, (Real)dt);
+    const double serialSeconds = GetClockSeconds() - start;
+
+    const PararealSettings settings = { (Method)fineMethod, (Real)dt, (Method)coarseMethod, coarseSteps, iterations, (Real)tolerance };
+    start = GetClockSeconds();
+    const PararealResult result = IntegrateParareal(&solver, &parallel, steps, &settings);
+    const double pararealSeconds = GetClockSeconds() - start;
+
+    double deviation = 0.0;
+    double scale = 0.0;
+    for (int i = 0; i < GetBodySystemDim(&serial); i++) {
+        deviation = fmax(deviation, fabs((double)parallel.state[i] - (double)serial.state[i]));
+        scale = fmax(scale, fabs((double)serial.state[i]));
+    }
+
+    printf("fine=%s coarse=%s x%d per slice steps=%ld dt=%g slices=%d threads=%d\n", GetMethodName((Method)fineMethod),
+           GetMethodName((Method)coarseMethod), coarseSteps, steps, dt, solver.sliceCount, GetThreadPoolSize(pool));
+    printf("serial:   %10.3f s %14lld force evaluations\n", serialSeconds, serial.forceEvaluations);
+    printf("parareal: %10.3f s %14lld force evaluations, %d iterations%s, last change %.3e\n", pararealSeconds,
+           parallel.forceEvaluations, result.iterations, result.converged ? "" : " (not converged)", result.change);
+    printf("critical path=%lld force evaluations, speedup with a core per slice=%.2fx\n", result.criticalEvaluations,
+           (double)serial.forceEvaluations / (double)result.criticalEvaluations);
+    printf("speedup=%.2fx deviation from serial=%.3e (relative %.3e)\n", serialSeconds / pararealSeconds, deviation,
+           scale > 0.0 ? deviation / scale : deviation);
+
+    UnloadPararealSolver(solver);
+    UnloadBodySystem(serial);
+    UnloadBodySystem(parallel);
+    DestroyThreadPool(pool);
+    return 0;
+}
@@ -0,0 +1,137 @@
+// Throughput and accuracy of the precision this binary was built with. CMake builds it
+// once per GABRK_PRECISION as precision_bench_<precision>, and the run_precision_bench
+// target runs them all into one CSV table.
+//
+// The orbit rows integrate the two-body circular orbit for many periods at time steps
+// small enough that round-off, not truncation, dominates the error. Angular momentum is
+// conserved exactly by the symplectic methods, so its drift is round-off alone. The
+// throughput rows time N-body steps where the force kernel dominates.
+//
+//   precision_bench_<precision> [--no-header] [--horizon 400000] [--threads N]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/bodies.h"
+#include "core/gravity.h"
+#include "core/threadpool.h"
+
+typedef struct {
+    Method method;
+    ForceSolver forceSolver;
+    int bodies;
+    Real dt;
+    long steps; // Fixed step count for throughput rows, 0 to run the orbit for the whole horizon
+} Case;
+
+static const Case cases[] = {
+    { Velocity_Verlet, FORCE_DIRECT, 2, 60.0, 0 },
+    { Velocity_Verlet, FORCE_DIRECT, 2, 6.0, 0 },
+    { Yoshida6, FORCE_DIRECT, 2, 60.0, 0 },
+    { Yoshida6, FORCE_DIRECT, 2, 6.0, 0 },
+    { RK4, FORCE_DIRECT, 2, 60.0, 0 },
+    { RK4, FORCE_DIRECT, 2, 6.0, 0 },
+    { RK45_DormandPrince, FORCE_DIRECT, 2, 60.0, 0 },
+    { RK45_DormandPrince, FORCE_DIRECT, 2, 6.0, 0 },
+    { RK4, FORCE_DIRECT, 2048, 0.5, 20 },
+    { RK4, FORCE_BARNES_HUT, 16384, 0.5, 10 },
+};
+
+// Light bodies on circular orbits around a central mass
+static void InitDisk(BodySystem* system)
+{
+    const float centralMass = 1000.0f;
+    system->px[0] = 0.0f; system->py[0] = 0.0f;
+    system->vx[0] = 0.0f; system->vy[0] = 0.0f;
+    system->mass[0] = centralMass;
+
+    srand(2024);
+    for (int i = 1; i < system->count; i++) {
+        const double radius = RandomRange(50.0f, 1000.0f);
+        const double angle = RandomRange(0.0f, 6.2831853f);
+        const double speed = sqrt(GRAVITY_G * centralMass / radius);
+        system->px[i] = (Real)(radius * cos(angle));
+        system->py[i] = (Real)(radius * sin(angle));
+        system->vx[i] = (Real)(-speed * sin(angle));
+        system->vy[i] = (Real)(speed * cos(angle));
+        system->mass[i] = 1e-3f;
+    }
+}
+
+static double RelativeChange(double value, double initial)
+{
+    return (initial != 0.0) ? fabs((value - initial) / initial) : fabs(value);
+}
+
+int main(int argc, char** argv)
+{
+    int header = 1;
+    double horizon = 400000.0;
+    int threads = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-header") == 0) header = 0;
+        else if (strcmp(argv[i], "--horizon") == 0 && i + 1 < argc) horizon = atof(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    ThreadPool* pool = (threads >= 0) ? CreateThreadPool(threads) : NULL;
+
+    if (header) {
+        printf("precision,method,force,bodies,dt,steps,ns_per_step,energy_drift,max_energy_drift,angular_momentum_drift\n");
+    }
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const Case* test = &cases[c];
+        BodySystem system = LoadBodySystem(test->bodies);
+        if (system.count == 0) continue;
+        system.forceSolver = test->forceSolver;
+        system.pool = pool;
+
+        if (test->bodies == 2) ResetTwoBodyOrbit(&system);
+        else InitDisk(&system);
+
+        const long steps = test->steps ? test->steps : (long)ceil(horizon / test->dt);
+        const long sampleEvery = (steps > 64) ? steps / 64 : 1;
+        const double initialEnergy = ComputeKineticEnergy(&system) + ComputePotentialEnergy(&system);
+        const double initialMomentum = ComputeAngularMomentum(&system);
+
+        double seconds = 0.0;
+        double maxEnergyDrift = 0.0;
+        for (long done = 0; done < steps;) {
+            const long batch = (steps - done < sampleEvery) ? steps - done : sampleEvery;
+
+            const double start = GetClockSeconds();
+            for (long s = 0; s < batch; s++) StepBodySystem(&system, test->method, test->dt);
+            seconds += GetClockSeconds() - start;
+            done += batch;
+
+            // Skipped for the large systems, where the O(N^2) energy would dominate the run
+            if (test->bodies <= 2048) {
+                const double drift = RelativeChange(ComputeKineticEnergy(&system) + ComputePotentialEnergy(&system), initialEnergy);
+                if (drift > maxEnergyDrift || isnan(drift)) maxEnergyDrift = drift;
+            }
+        }
+
+        const double energyDrift = RelativeChange(ComputeKineticEnergy(&system) + ComputePotentialEnergy(&system), initialEnergy);
+        const double momentumDrift = RelativeChange(ComputeAngularMomentum(&system), initialMomentum);
+        if (energyDrift > maxEnergyDrift || isnan(energyDrift)) maxEnergyDrift = energyDrift;
+
+        printf("%s,%s,%s,%d,%g,%ld,%.1f,%.6e,%.6e,%.6e\n", GABRK_PRECISION_NAME, GetMethodName(test->method),
+               forceSolverNames[test->forceSolver], system.count, (double)test->dt, steps, seconds * 1e9 / steps,
+               energyDrift, maxEnergyDrift, momentumDrift);
+        fflush(stdout);
+
+        system.pool = NULL;
+        UnloadBodySystem(system);
+    }
+
+    DestroyThreadPool(pool);
+    return 0;
+}
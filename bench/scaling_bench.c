@@ -0,0 +1,80 @@
+// Thread scaling of StepBodySystem from one thread to every core, for every force solver.
+// Also checks that every pool size produces a bit-identical state and that the timed
+// steps, which follow one warm-up step, make no core allocations.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/allocator.h"
+#include "core/bodies.h"
+#include "core/threadpool.h"
+
+static void InitDisk(BodySystem* system)
+{
+    srand(99);
+    for (int i = 0; i < system->count; i++) {
+        const float radius = 1000.0f * sqrtf(RandomRange(0.0f, 1.0f));
+        const float angle = RandomRange(0.0f, 6.2831853f);
+        system->px[i] = radius * cosf(angle);
+        system->py[i] = radius * sinf(angle);
+        system->vx[i] = 0.0f;
+        system->vy[i] = 0.0f;
+        system->mass[i] = RandomRange(1.0f, 10.0f);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int count = (argc > 1) ? atoi(argv[1]) : 8192;
+    const int steps = (argc > 2 && atoi(argv[2]) > 1) ? atoi(argv[2]) : 4;
+    const int maxThreads = GetCpuCount();
+
+    BodySystem system = LoadBodySystem(count);
+    Real* reference = malloc(GetBodySystemDim(&system) * sizeof(Real));
+    if (system.count == 0 || !reference) return 1;
+
+    printf("%-11s %-8s %12s %9s %10s %7s\n", "solver", "threads", "ms/step", "speedup", "identical", "allocs");
+
+    for (int solver = 0; solver < FORCE_SOLVER_COUNT; solver++) {
+        double baseline = 0.0;
+
+        for (int threads = 1;; threads = (threads * 2 < maxThreads) ? threads * 2 : maxThreads) {
+            ThreadPool* pool = CreateThreadPool(threads);
+            if (!pool) return 1;
+
+            InitDisk(&system);
+            system.forceSolver = (ForceSolver)solver;
+            system.pool = pool;
+
+            StepBodySystem(&system, RK4, 1.0f);
+            LockCoreAllocations(true);
+            const long long allocationsBefore = GetLockedAllocationCount();
+
+            const double start = GetClockSeconds();
+            for (int s = 1; s < steps; s++) StepBodySystem(&system, RK4, 1.0f);
+            const double perStep = (GetClockSeconds() - start) / (steps - 1);
+
+            const long long allocations = GetLockedAllocationCount() - allocationsBefore;
+            LockCoreAllocations(false);
+
+            if (threads == 1) {
+                baseline = perStep;
+                memcpy(reference, system.state, GetBodySystemDim(&system) * sizeof(Real));
+            }
+            const int identical = memcmp(reference, system.state, GetBodySystemDim(&system) * sizeof(Real)) == 0;
+
+            printf("%-11s %-8d %12.2f %8.2fx %10s %7lld\n", forceSolverNames[solver], threads, perStep * 1e3,
+                   baseline / perStep, identical ? "yes" : "NO", allocations);
+
+            system.pool = NULL;
+            DestroyThreadPool(pool);
+            if (threads == maxThreads) break;
+        }
+    }
+
+    free(reference);
+    UnloadBodySystem(system);
+    return 0;
+}
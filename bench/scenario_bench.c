@@ -0,0 +1,102 @@
+// Startup cost of large scenarios: generating each kind serially and across the pool,
+// then loading the same bodies back from a binary scenario and from CSV. Every result is
+// checked against the generated bodies; the files are removed afterwards.
+//
+//   scenario_bench [--count 1000000] [--threads 0] [--path scenario_bench]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/scenario.h"
+#include "core/threadpool.h"
+
+// Whether both systems hold the same bodies bit for bit
+static int SameBodies(const BodySystem* a, const BodySystem* b)
+{
+    return a->count == b->count && memcmp(a->state, b->state, 4 * (size_t)a->count * sizeof(Real)) == 0 &&
+           memcmp(a->mass, b->mass, a->count * sizeof(ForceReal)) == 0;
+}
+
+static int WriteCsv(const char* path, const BodySystem* system)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) return 0;
+
+    const int digits = (sizeof(Real) == sizeof(float)) ? 9 : 17;
+    fprintf(file, "x,y,vx,vy,mass\n");
+    for (int i = 0; i < system->count; i++) {
+        fprintf(file, "%.*g,%.*g,%.*g,%.*g,%.*g\n", digits, (double)system->px[i], digits, (double)system->py[i],
+                digits, (double)system->vx[i], digits, (double)system->vy[i], digits, (double)system->mass[i]);
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    int count = 1000000;
+    int threads = 0;
+    const char* path = "scenario_bench";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--count") == 0) count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--path") == 0) path = argv[i + 1];
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    ThreadPool* pool = CreateThreadPool(threads);
+    char binaryPath[512], csvPath[512];
+    snprintf(binaryPath, sizeof(binaryPath), "%s.scn", path);
+    snprintf(csvPath, sizeof(csvPath), "%s.csv", path);
+
+    printf("bodies=%d threads=%d precision=%s\n", count, GetThreadPoolSize(pool), GABRK_PRECISION_NAME);
+    printf("%-10s %12s %12s %8s %12s %12s %10s\n", "scenario", "serial ms", "pool ms", "same", "binary ms", "csv ms", "loaded");
+
+    int status = 0;
+    for (int kind = SCENARIO_PLUMMER; kind < SCENARIO_KIND_COUNT; kind++) {
+        const ScenarioSettings settings = CreateScenarioSettings((ScenarioKind)kind, count);
+
+        double start = GetClockSeconds();
+        BodySystem serial = GenerateScenario(&settings, NULL);
+        const double serialSeconds = GetClockSeconds() - start;
+
+        start = GetClockSeconds();
+        BodySystem parallel = GenerateScenario(&settings, pool);
+        const double poolSeconds = GetClockSeconds() - start;
+        if (serial.count == 0 || parallel.count == 0) return 1;
+
+        if (!WriteScenario(binaryPath, &parallel) || !WriteCsv(csvPath, &parallel)) {
+            fprintf(stderr, "Cannot write %s or %s\n", binaryPath, csvPath);
+            return 1;
+        }
+
+        start = GetClockSeconds();
+        BodySystem binary = LoadScenario(binaryPath, pool);
+        const double binarySeconds = GetClockSeconds() - start;
+
+        start = GetClockSeconds();
+        BodySystem text = LoadScenario(csvPath, pool);
+        const double textSeconds = GetClockSeconds() - start;
+
+        // Nine digits restore floats exactly; seventeen restore doubles
+        const int same = SameBodies(&serial, &parallel);
+        const int loaded = SameBodies(&parallel, &binary) && SameBodies(&parallel, &text);
+        printf("%-10s %12.1f %12.1f %8s %12.1f %12.1f %10s\n", scenarioKindNames[kind], serialSeconds * 1e3, poolSeconds * 1e3,
+               same ? "yes" : "NO", binarySeconds * 1e3, textSeconds * 1e3, loaded ? "exact" : "DIFFERS");
+        if (!same || !loaded) status = 1;
+
+        UnloadBodySystem(serial);
+        UnloadBodySystem(parallel);
+        UnloadBodySystem(binary);
+        UnloadBodySystem(text);
+    }
+
+    remove(binaryPath);
+    remove(csvPath);
+    DestroyThreadPool(pool);
+    return status;
+}
@@ -0,0 +1,162 @@
+// Step time and cache misses of the tree and cell-list solvers for bodies in creation
+// (random) order against bodies re-sorted along a Morton or Hilbert curve every few steps.
+// Misses come from the Linux perf counters and show as n/a where those are unavailable.
+//
+//   sort_bench [--count 65536] [--steps 20] [--sort-every 10]
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "core/bodies.h"
+#include "core/spatialsort.h"
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+typedef enum {
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+
+    COUNTER_COUNT
+} Counter;
+
+static int counters[COUNTER_COUNT] = { -1, -1 };
+
+static void OpenCounters(void)
+{
+#if defined(__linux__)
+    static const uint64_t configs[COUNTER_COUNT] = {
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    };
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = configs[c];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        counters[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+static void StartCounters(void)
+{
+#if defined(__linux__)
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        if (counters[c] < 0) continue;
+        ioctl(counters[c], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+// Negative where the counter is unavailable
+static void StopCounters(long long* values)
+{
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        values[c] = -1;
+#if defined(__linux__)
+        long long value = 0;
+        if (counters[c] >= 0 && ioctl(counters[c], PERF_EVENT_IOC_DISABLE, 0) == 0 &&
+            read(counters[c], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+            values[c] = value;
+        }
+#endif
+    }
+}
+
+static void FormatCount(char* text, size_t size, long long value, int steps)
+{
+    if (value < 0) snprintf(text, size, "n/a");
+    else snprintf(text, size, "%.3g", (double)value / steps);
+}
+
+// Bodies in a clustered disk, created in random order as a scenario file would list them
+static void InitCluster(BodySystem* system)
+{
+    srand(1234);
+    for (int i = 0; i < system->count; i++) {
+        const float radius = 2000.0f * powf(RandomRange(0.0f, 1.0f), 0.75f);
+        const float angle = RandomRange(0.0f, 6.2831853f);
+        system->px[i] = radius * cosf(angle);
+        system->py[i] = radius * sinf(angle);
+        system->vx[i] = 0.0f;
+        system->vy[i] = 0.0f;
+        system->mass[i] = RandomRange(1.0f, 10.0f);
+        system->ids[i] = i;
+    }
+    system->accelerationsValid = 0;
+}
+
+int main(int argc, char** argv)
+{
+    int count = 65536;
+    int steps = 20;
+    int sortEvery = 10;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--count") == 0) count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--steps") == 0) steps = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--sort-every") == 0) sortEvery = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (count < 2 || steps < 1 || sortEvery < 1) {
+        fprintf(stderr, "Invalid count, steps or sort interval\n");
+        return 1;
+    }
+
+    BodySystem system = LoadBodySystem(count);
+    if (system.count == 0) return 1;
+    OpenCounters();
+
+    static const ForceSolver solvers[] = { FORCE_BARNES_HUT, FORCE_CUTOFF };
+    printf("bodies=%d steps=%d sort every %d steps, one thread\n", count, steps, sortEvery);
+    printf("%-11s %-10s %12s %9s %14s %14s\n", "solver", "order", "ms/step", "speedup", "L1D miss/step", "LLC miss/step");
+
+    for (size_t s = 0; s < sizeof(solvers) / sizeof(solvers[0]); s++) {
+        double unsortedSeconds = 0.0;
+
+        // -1 keeps the creation order
+        for (int order = -1; order < SPATIAL_ORDER_COUNT; order++) {
+            InitCluster(&system);
+            system.forceSolver = solvers[s];
+            system.cutoff = 30.0f;
+            StepBodySystem(&system, Velocity_Verlet, 0.1f); // Warm up the tree and grid arrays
+
+            long long misses[COUNTER_COUNT];
+            StartCounters();
+            const double start = GetClockSeconds();
+            for (int step = 0; step < steps; step++) {
+                if (order >= 0 && step % sortEvery == 0) SortBodySystem(&system, (SpatialOrder)order);
+                StepBodySystem(&system, Velocity_Verlet, 0.1f);
+            }
+            const double seconds = (GetClockSeconds() - start) / steps;
+            StopCounters(misses);
+
+            if (order < 0) unsortedSeconds = seconds;
+
+            char l1[32], llc[32];
+            FormatCount(l1, sizeof(l1), misses[COUNTER_L1D_MISSES], steps);
+            FormatCount(llc, sizeof(llc), misses[COUNTER_LLC_MISSES], steps);
+            printf("%-11s %-10s %12.2f %8.2fx %14s %14s\n", forceSolverNames[solvers[s]],
+                   (order < 0) ? "creation" : spatialOrderNames[order], seconds * 1e3, unsortedSeconds / seconds, l1, llc);
+        }
+    }
+
+    UnloadBodySystem(system);
+    return 0;
+}
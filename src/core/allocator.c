@@ -0,0 +1,57 @@
+#include "allocator.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+static atomic_llong allocationCount;
+static atomic_llong lockedAllocationCount;
+static atomic_bool allocationsLocked;
+
+static void CountAllocation(void)
+{
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+
+    if (atomic_load_explicit(&allocationsLocked, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&lockedAllocationCount, 1, memory_order_relaxed);
+        assert(!"core allocation after warm-up");
+    }
+}
+
+void* CoreAlloc(size_t size)
+{
+    CountAllocation();
+    return malloc(size);
+}
+
+void* CoreCalloc(size_t count, size_t size)
+{
+    CountAllocation();
+    return calloc(count, size);
+}
+
+void* CoreRealloc(void* pointer, size_t size)
+{
+    CountAllocation();
+    return realloc(pointer, size);
+}
+
+void CoreFree(void* pointer)
+{
+    free(pointer);
+}
+
+long long GetCoreAllocationCount(void)
+{
+    return atomic_load_explicit(&allocationCount, memory_order_relaxed);
+}
+
+void LockCoreAllocations(bool locked)
+{
+    atomic_store_explicit(&allocationsLocked, locked, memory_order_relaxed);
+}
+
+long long GetLockedAllocationCount(void)
+{
+    return atomic_load_explicit(&lockedAllocationCount, memory_order_relaxed);
+}
@@ -0,0 +1,22 @@
+#ifndef GABRK_ALLOCATOR_H
+#define GABRK_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Every heap allocation in the core goes through these, so allocations can be counted
+// and forbidden once a simulation has warmed up. Same contracts as malloc and friends.
+void* CoreAlloc(size_t size);
+void* CoreCalloc(size_t count, size_t size);
+void* CoreRealloc(void* pointer, size_t size);
+void CoreFree(void* pointer);
+
+// Allocations (not frees) since the program started
+long long GetCoreAllocationCount(void);
+
+// While locked, every allocation is counted as a violation and fails an assert in debug
+// builds. Lock after the warm-up steps to check that stepping is allocation-free.
+void LockCoreAllocations(bool locked);
+long long GetLockedAllocationCount(void);
+
+#endif
@@ -0,0 +1,46 @@
+#include "arena.h"
+#include "allocator.h"
+
+#include <stdint.h>
+#include <string.h>
+
+Arena LoadArena(size_t capacity)
+{
+    Arena arena = { 0 };
+
+    // Over-allocated by one alignment so the base can be rounded up; the raw pointer
+    // is kept just before the aligned base for UnloadArena
+    unsigned char* raw = CoreAlloc(capacity + ARENA_ALIGNMENT + sizeof(void*));
+    if (!raw) return arena;
+
+    const uintptr_t aligned = ((uintptr_t)(raw + sizeof(void*)) + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+    arena.base = (unsigned char*)aligned;
+    memcpy(arena.base - sizeof(void*), &raw, sizeof(void*));
+    arena.capacity = capacity;
+    return arena;
+}
+
+void UnloadArena(Arena arena)
+{
+    if (!arena.base) return;
+
+    void* raw = NULL;
+    memcpy(&raw, arena.base - sizeof(void*), sizeof(void*));
+    CoreFree(raw);
+}
+
+void* PushArena(Arena* arena, size_t size)
+{
+    const size_t pushSize = GetArenaPushSize(size);
+    if (pushSize > arena->capacity - arena->used) return NULL;
+
+    void* pointer = arena->base + arena->used;
+    arena->used += pushSize;
+    memset(pointer, 0, size);
+    return pointer;
+}
+
+void ResetArena(Arena* arena)
+{
+    arena->used = 0;
+}
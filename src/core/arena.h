@@ -0,0 +1,30 @@
+#ifndef GABRK_ARENA_H
+#define GABRK_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 64 // Cache line, and enough for any SIMD load
+
+// Bump allocator over one block allocated up front. Buffers pushed from it stay valid
+// until the arena is reset or unloaded; pushing never allocates.
+typedef struct {
+    unsigned char* base;
+    size_t capacity;
+    size_t used;
+} Arena;
+
+// Bytes a push of size bytes consumes, for sizing an arena before loading it
+static inline size_t GetArenaPushSize(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+// Returns an arena with capacity 0 if the block could not be allocated
+Arena LoadArena(size_t capacity);
+void UnloadArena(Arena arena);
+
+// Returns size zeroed bytes aligned to ARENA_ALIGNMENT, or NULL if the arena is full
+void* PushArena(Arena* arena, size_t size);
+void ResetArena(Arena* arena);
+
+#endif
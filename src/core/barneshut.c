@@ -0,0 +1,232 @@
+#include "barneshut.h"
+#include "allocator.h"
+#include "gravity.h"
+#include "profiler.h"
+
+#include <tgmath.h>
+
+void UnloadQuadTree(QuadTree tree)
+{
+    CoreFree(tree.nodes);
+    CoreFree(tree.nextBody);
+}
+
+static int ReserveNodes(QuadTree* tree, int needed)
+{
+    if (needed <= tree->nodeCapacity) return 1;
+
+    QuadNode* nodes = CoreRealloc(tree->nodes, needed * sizeof(QuadNode));
+    if (!nodes) return 0;
+
+    tree->nodes = nodes;
+    tree->nodeCapacity = needed;
+    return 1;
+}
+
+static int ReserveBodies(QuadTree* tree, int count)
+{
+    if (count <= tree->bodyCapacity) return 1;
+
+    int* nextBody = CoreRealloc(tree->nextBody, count * sizeof(int));
+    if (!nextBody) return 0;
+
+    tree->nextBody = nextBody;
+    tree->bodyCapacity = count;
+    return 1;
+}
+
+static void InitNode(QuadNode* node, ForceReal centerX, ForceReal centerY, ForceReal halfSize)
+{
+    *node = (QuadNode){ centerX, centerY, halfSize, 0.0f, 0.0f, 0.0f, -1, -1 };
+}
+
+static int Quadrant(const QuadNode* node, ForceReal x, ForceReal y)
+{
+    return (x >= node->centerX) | ((y >= node->centerY) << 1);
+}
+
+// Returns 0 if the node pool is full. It never grows here, so tightly clustered
+// bodies cannot make a rebuild allocate after the first one.
+static int Subdivide(QuadTree* tree, int index)
+{
+    if (tree->nodeCount + 4 > tree->nodeCapacity) return 0;
+
+    const QuadNode parent = tree->nodes[index];
+    const ForceReal quarter = 0.5f * parent.halfSize;
+    const int first = tree->nodeCount;
+    tree->nodeCount += 4;
+
+    for (int q = 0; q < 4; q++) {
+        const ForceReal x = parent.centerX + ((q & 1) ? quarter : -quarter);
+        const ForceReal y = parent.centerY + ((q & 2) ? quarter : -quarter);
+        InitNode(&tree->nodes[first + q], x, y, quarter);
+    }
+
+    tree->nodes[index].firstChild = first;
+    return 1;
+}
+
+static void PushBody(QuadTree* tree, QuadNode* node, int body)
+{
+    tree->nextBody[body] = node->firstBody;
+    node->firstBody = body;
+}
+
+static void InsertBody(QuadTree* tree, const ForceReal* px, const ForceReal* py, int body)
+{
+    int index = 0;
+    int depth = 0;
+
+    for (;;) {
+        QuadNode* node = &tree->nodes[index];
+
+        if (node->firstChild >= 0) {
+            index = node->firstChild + Quadrant(node, px[body], py[body]);
+            depth++;
+            continue;
+        }
+
+        int residents = 0;
+        for (int b = node->firstBody; b >= 0; b = tree->nextBody[b]) residents++;
+
+        if (residents < QUADTREE_LEAF_CAPACITY || depth >= QUADTREE_MAX_DEPTH || !Subdivide(tree, index)) {
+            PushBody(tree, &tree->nodes[index], body);
+            return;
+        }
+
+        // Full leaf: hand its bodies down to the new children and retry one level deeper
+        node = &tree->nodes[index];
+        int b = node->firstBody;
+        node->firstBody = -1;
+        while (b >= 0) {
+            const int next = tree->nextBody[b];
+            PushBody(tree, &tree->nodes[node->firstChild + Quadrant(node, px[b], py[b])], b);
+            b = next;
+        }
+    }
+}
+
+static int BuildTree(QuadTree* tree, const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count)
+{
+    tree->nodeCount = 0;
+    if (count <= 0) return 1;
+    if (!ReserveBodies(tree, count) || !ReserveNodes(tree, QUADTREE_NODES_PER_BODY * count + 1)) return 0;
+
+    ForceReal minX = px[0], maxX = px[0], minY = py[0], maxY = py[0];
+    for (int i = 1; i < count; i++) {
+        minX = fmin(minX, px[i]); maxX = fmax(maxX, px[i]);
+        minY = fmin(minY, py[i]); maxY = fmax(maxY, py[i]);
+    }
+
+    // Slightly enlarged so bodies on the max edge still fall inside the root cell
+    const ForceReal halfSize = 0.5f * fmax(maxX - minX, maxY - minY) * 1.0001f + 1e-3f;
+    InitNode(&tree->nodes[0], 0.5f * (minX + maxX), 0.5f * (minY + maxY), halfSize);
+    tree->nodeCount = 1;
+
+    for (int i = 0; i < count; i++) InsertBody(tree, px, py, i);
+
+    for (int n = tree->nodeCount - 1; n >= 0; n--) {
+        QuadNode* node = &tree->nodes[n];
+        ForceReal m = 0.0f, mx = 0.0f, my = 0.0f;
+
+        if (node->firstChild >= 0) {
+            for (int q = 0; q < 4; q++) {
+                const QuadNode* child = &tree->nodes[node->firstChild + q];
+                m += child->mass;
+                mx += child->mass * child->comX;
+                my += child->mass * child->comY;
+            }
+        }
+        else {
+            for (int b = node->firstBody; b >= 0; b = tree->nextBody[b]) {
+                m += mass[b];
+                mx += mass[b] * px[b];
+                my += mass[b] * py[b];
+            }
+        }
+
+        node->mass = m;
+        node->comX = (m > 0.0f) ? mx / m : node->centerX;
+        node->comY = (m > 0.0f) ? my / m : node->centerY;
+    }
+    return 1;
+}
+
+int BuildQuadTree(QuadTree* tree, const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count)
+{
+    PROFILE_BEGIN(PROFILE_TREE_BUILD);
+    const int built = BuildTree(tree, px, py, mass, count);
+    PROFILE_END(PROFILE_TREE_BUILD);
+    return built;
+}
+
+void EvaluateBarnesHutRange(const QuadTree* tree, const ForceReal* px, const ForceReal* py, const ForceReal* mass,
+                            int begin, int end, ForceReal theta, ForceReal* ax, ForceReal* ay, ForceReal* potential)
+{
+    if (tree->nodeCount == 0) return;
+
+    const ForceReal eps2 = GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+    const ForceReal theta2 = theta * theta;
+    int stack[4 * QUADTREE_MAX_DEPTH + 4];
+
+    for (int i = begin; i < end; i++) {
+        const ForceReal xi = px[i];
+        const ForceReal yi = py[i];
+        ForceReal axi = 0.0f;
+        ForceReal ayi = 0.0f;
+        ForceReal phii = 0.0f;
+
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const QuadNode* node = &tree->nodes[stack[--top]];
+            if (node->mass == 0.0f) continue;
+
+            if (node->firstChild < 0) {
+                for (int j = node->firstBody; j >= 0; j = tree->nextBody[j]) {
+                    if (j == i) continue;
+                    const ForceReal dx = px[j] - xi;
+                    const ForceReal dy = py[j] - yi;
+                    const ForceReal invDistance = 1.0f / sqrt(dx * dx + dy * dy + eps2);
+                    const ForceReal scale = GRAVITY_G * mass[j] * invDistance * invDistance * invDistance;
+                    axi += dx * scale;
+                    ayi += dy * scale;
+                    phii += mass[j] * invDistance;
+                }
+                continue;
+            }
+
+            const ForceReal dx = node->comX - xi;
+            const ForceReal dy = node->comY - yi;
+            const ForceReal distanceSquared = dx * dx + dy * dy;
+            const ForceReal size = 2.0f * node->halfSize;
+
+            // A cell containing the body itself is always opened, so no body is approximated by its own mass
+            const int containsBody = fabs(xi - node->centerX) <= node->halfSize && fabs(yi - node->centerY) <= node->halfSize;
+
+            if (!containsBody && size * size < theta2 * distanceSquared) {
+                const ForceReal invDistance = 1.0f / sqrt(distanceSquared + eps2);
+                const ForceReal scale = GRAVITY_G * node->mass * invDistance * invDistance * invDistance;
+                axi += dx * scale;
+                ayi += dy * scale;
+                phii += node->mass * invDistance;
+            }
+            else {
+                for (int q = 0; q < 4; q++) stack[top++] = node->firstChild + q;
+            }
+        }
+
+        ax[i] = axi;
+        ay[i] = ayi;
+        if (potential) potential[i] = -GRAVITY_G * phii;
+    }
+}
+
+int ComputeAccelerationsBarnesHut(QuadTree* tree, const ForceReal* px, const ForceReal* py, const ForceReal* mass,
+                                  int count, ForceReal theta, ForceReal* ax, ForceReal* ay, ForceReal* potential)
+{
+    if (!BuildQuadTree(tree, px, py, mass, count)) return 0;
+    EvaluateBarnesHutRange(tree, px, py, mass, 0, count, theta, ax, ay, potential);
+    return 1;
+}
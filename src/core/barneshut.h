@@ -0,0 +1,47 @@
+#ifndef GABRK_BARNESHUT_H
+#define GABRK_BARNESHUT_H
+
+#include "precision.h"
+
+#define QUADTREE_LEAF_CAPACITY 8 // Leaves split once they would hold more bodies than this
+#define QUADTREE_MAX_DEPTH 32     // Leaves at this depth never split, whatever their body count
+#define QUADTREE_NODES_PER_BODY 2 // Node pool size; typical distributions use under half a node per body
+
+// Children of an internal node are allocated together and always have a higher
+// index than their parent, so one reverse sweep over the array aggregates masses.
+typedef struct {
+    ForceReal centerX, centerY, halfSize; // Cell geometry
+    ForceReal comX, comY, mass;           // Center of mass and total mass of the cell
+    int firstChild;                   // Index of the first of four children, -1 for leaves
+    int firstBody;                    // Head of the leaf's body list, -1 if empty
+} QuadNode;
+
+// Node pool and per-body leaf links. Both are sized for the body count on the first
+// build and reused across rebuilds, so later rebuilds of as many bodies never allocate.
+typedef struct {
+    QuadNode* nodes;
+    int nodeCount;
+    int nodeCapacity;
+    int* nextBody;
+    int bodyCapacity;
+} QuadTree;
+
+void UnloadQuadTree(QuadTree tree);
+
+// Returns 0 if the node pool or body links could not be allocated, leaving the tree empty.
+// Subdivisions past the end of the pool leave their bodies in a fuller leaf instead.
+int BuildQuadTree(QuadTree* tree, const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count);
+
+// Evaluates accelerations of bodies [begin, end) against a tree built from the same
+// positions. Read-only on the tree, so disjoint ranges can run concurrently. potential,
+// unless NULL, receives each body's potential from the same cells and bodies.
+void EvaluateBarnesHutRange(const QuadTree* tree, const ForceReal* px, const ForceReal* py, const ForceReal* mass,
+                            int begin, int end, ForceReal theta, ForceReal* ax, ForceReal* ay, ForceReal* potential);
+
+// Rebuilds the tree from the given positions and evaluates accelerations with the
+// opening criterion size / distance < theta. theta = 0 degenerates to direct summation.
+// Returns 0, leaving ax and ay untouched, if the tree could not be built.
+int ComputeAccelerationsBarnesHut(QuadTree* tree, const ForceReal* px, const ForceReal* py, const ForceReal* mass,
+                                  int count, ForceReal theta, ForceReal* ax, ForceReal* ay, ForceReal* potential);
+
+#endif
@@ -0,0 +1,245 @@
+#include "blockstep.h"
+#include "gravity.h"
+#include "profiler.h"
+
+#include <tgmath.h>
+
+BlockStepper LoadBlockStepper(int count, int maxLevel, Real eta)
+{
+    BlockStepper stepper = { 0 };
+    if (count <= 0) return stepper;
+
+    const size_t workspaceSize = 2 * GetArenaPushSize(2 * (size_t)count * sizeof(double)) +
+                                 GetArenaPushSize(count * sizeof(long long)) +
+                                 2 * GetArenaPushSize(count * sizeof(int)) +
+                                 3 * GetArenaPushSize(4 * (size_t)count * sizeof(double));
+    stepper.workspace = LoadArena(workspaceSize);
+    if (!stepper.workspace.base) return (BlockStepper){ 0 };
+
+    stepper.state = PushArena(&stepper.workspace, 4 * (size_t)count * sizeof(double));
+    stepper.accelerations = PushArena(&stepper.workspace, 2 * (size_t)count * sizeof(double));
+    stepper.jerks = PushArena(&stepper.workspace, 2 * (size_t)count * sizeof(double));
+    stepper.times = PushArena(&stepper.workspace, count * sizeof(long long));
+    stepper.levels = PushArena(&stepper.workspace, count * sizeof(int));
+    stepper.active = PushArena(&stepper.workspace, count * sizeof(int));
+    stepper.predicted = PushArena(&stepper.workspace, 4 * (size_t)count * sizeof(double));
+    stepper.forces = PushArena(&stepper.workspace, 4 * (size_t)count * sizeof(double));
+
+    stepper.count = count;
+    stepper.maxLevel = (maxLevel < 0) ? 0 : (maxLevel > BLOCKSTEP_MAX_LEVEL) ? BLOCKSTEP_MAX_LEVEL : maxLevel;
+    stepper.eta = (eta > 0) ? eta : (Real)0.02;
+    return stepper;
+}
+
+void UnloadBlockStepper(BlockStepper stepper)
+{
+    UnloadArena(stepper.workspace);
+}
+
+static long long GetLevelTicks(const BlockStepper* stepper, int level)
+{
+    return 1LL << (stepper->maxLevel - level);
+}
+
+// Shortest level whose step is no longer than desired; NaN stays at the base step
+static int GetLevel(const BlockStepper* stepper, double desired)
+{
+    int level = 0;
+    double step = stepper->dt;
+    while (level < stepper->maxLevel && step > desired) {
+        step *= 0.5;
+        level++;
+    }
+    return level;
+}
+
+typedef struct {
+    const BlockStepper* stepper;
+    const ForceReal* mass;
+    int activeCount;
+} BlockForceJob;
+
+// Acceleration and jerk of each active body, summed over every predicted body. The self
+// term vanishes thanks to softening, as in ComputeAccelerationsRange.
+static void BlockForceRange(int begin, int end, void* user)
+{
+    const BlockForceJob* job = user;
+    const BlockStepper* stepper = job->stepper;
+    const int count = stepper->count;
+    const int activeCount = job->activeCount;
+    const double* px = stepper->predicted;
+    const double* py = px + count;
+    const double* vx = px + 2 * count;
+    const double* vy = px + 3 * count;
+    const ForceReal* mass = job->mass;
+    const double eps2 = (double)GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+
+    for (int k = begin; k < end; k++) {
+        const int i = stepper->active[k];
+        double axi = 0.0, ayi = 0.0;
+        double jxi = 0.0, jyi = 0.0;
+
+        for (int j = 0; j < count; j++) {
+            const double dx = px[j] - px[i];
+            const double dy = py[j] - py[i];
+            const double dvx = vx[j] - vx[i];
+            const double dvy = vy[j] - vy[i];
+            const double invDistanceSquared = 1.0 / (dx * dx + dy * dy + eps2);
+            const double invDistance = sqrt(invDistanceSquared);
+            const double scale = GRAVITY_G * mass[j] * invDistance * invDistanceSquared;
+            const double radial = 3.0 * (dx * dvx + dy * dvy) * invDistanceSquared;
+
+            axi += dx * scale;
+            ayi += dy * scale;
+            jxi += (dvx - radial * dx) * scale;
+            jyi += (dvy - radial * dy) * scale;
+        }
+
+        stepper->forces[k] = axi;
+        stepper->forces[activeCount + k] = ayi;
+        stepper->forces[2 * activeCount + k] = jxi;
+        stepper->forces[3 * activeCount + k] = jyi;
+    }
+}
+
+static void EvaluateActiveForces(BodySystem* system, BlockStepper* stepper, int activeCount)
+{
+    PROFILE_BEGIN(PROFILE_FORCES);
+    BlockForceJob job = { stepper, system->mass, activeCount };
+    ParallelFor(system->pool, activeCount, BlockForceRange, &job);
+    stepper->bodyForces += activeCount;
+    PROFILE_END(PROFILE_FORCES);
+}
+
+// Evaluates every body at the current state and picks the starting levels from the
+// simple criterion eta / 2 * |a| / |j|, since higher derivatives are not known yet
+static void StartBlockSteps(BodySystem* system, BlockStepper* stepper, Real dt)
+{
+    const int count = stepper->count;
+    for (int i = 0; i < 4 * count; i++) stepper->state[i] = system->state[i];
+    for (int i = 0; i < 4 * count; i++) stepper->predicted[i] = stepper->state[i];
+    for (int i = 0; i < count; i++) stepper->active[i] = i;
+    EvaluateActiveForces(system, stepper, count);
+
+    stepper->dt = dt;
+    for (int i = 0; i < count; i++) {
+        const double ax = stepper->forces[i], ay = stepper->forces[count + i];
+        const double jx = stepper->forces[2 * count + i], jy = stepper->forces[3 * count + i];
+        stepper->accelerations[i] = ax;
+        stepper->accelerations[count + i] = ay;
+        stepper->jerks[i] = jx;
+        stepper->jerks[count + i] = jy;
+
+        const double jerk = sqrt(jx * jx + jy * jy);
+        stepper->levels[i] = (jerk > 0.0) ? GetLevel(stepper, 0.5 * stepper->eta * sqrt(ax * ax + ay * ay) / jerk) : 0;
+        stepper->times[i] = 0;
+    }
+    stepper->valid = 1;
+}
+
+// Taylor series of every body from its own time to the block time, to third order
+static void PredictBodies(BlockStepper* stepper, long long time, double tick)
+{
+    const int count = stepper->count;
+    for (int axis = 0; axis < 2; axis++) {
+        const double* position = stepper->state + axis * count;
+        const double* velocity = stepper->state + (2 + axis) * count;
+        const double* acceleration = stepper->accelerations + axis * count;
+        const double* jerk = stepper->jerks + axis * count;
+        double* predictedPosition = stepper->predicted + axis * count;
+        double* predictedVelocity = stepper->predicted + (2 + axis) * count;
+
+        for (int i = 0; i < count; i++) {
+            const double h = (double)(time - stepper->times[i]) * tick;
+            predictedPosition[i] = position[i] + h * (velocity[i] + h * (acceleration[i] / 2.0 + h * jerk[i] / 6.0));
+            predictedVelocity[i] = velocity[i] + h * (acceleration[i] + h * jerk[i] / 2.0);
+        }
+    }
+}
+
+// Hermite corrector for the active bodies, then each body's next level from the Aarseth
+// criterion on the acceleration and its first three derivatives at the new time
+static void CorrectActiveBodies(BlockStepper* stepper, int activeCount, long long time, double tick)
+{
+    const int count = stepper->count;
+    for (int k = 0; k < activeCount; k++) {
+        const int i = stepper->active[k];
+        const double h = (double)GetLevelTicks(stepper, stepper->levels[i]) * tick;
+        double accelerationSquared = 0.0, jerkSquared = 0.0, snapSquared = 0.0, crackleSquared = 0.0;
+
+        for (int axis = 0; axis < 2; axis++) {
+            const double a0 = stepper->accelerations[axis * count + i];
+            const double j0 = stepper->jerks[axis * count + i];
+            const double a1 = stepper->forces[axis * activeCount + k];
+            const double j1 = stepper->forces[(2 + axis) * activeCount + k];
+
+            // Snap and crackle at the old time from the Hermite interpolant through both ends
+            const double snap = (-6.0 * (a0 - a1) - h * (4.0 * j0 + 2.0 * j1)) / (h * h);
+            const double crackle = (12.0 * (a0 - a1) + 6.0 * h * (j0 + j1)) / (h * h * h);
+            const double h2 = h * h;
+            stepper->state[axis * count + i] = stepper->predicted[axis * count + i] + h2 * h2 * (snap / 24.0 + h * crackle / 120.0);
+            stepper->state[(2 + axis) * count + i] = stepper->predicted[(2 + axis) * count + i] + h2 * h * (snap / 6.0 + h * crackle / 24.0);
+
+            stepper->accelerations[axis * count + i] = a1;
+            stepper->jerks[axis * count + i] = j1;
+            const double newSnap = snap + h * crackle;
+            accelerationSquared += a1 * a1;
+            jerkSquared += j1 * j1;
+            snapSquared += newSnap * newSnap;
+            crackleSquared += crackle * crackle;
+        }
+        stepper->times[i] = time;
+
+        const double numerator = sqrt(accelerationSquared * snapSquared) + jerkSquared;
+        const double denominator = sqrt(jerkSquared * crackleSquared) + snapSquared;
+        if (!(denominator > 0.0)) continue;
+
+        // Shorter steps start at once; a longer one only where it lines up with the time grid
+        const double desired = sqrt(stepper->eta * numerator / denominator);
+        int level = stepper->levels[i];
+        if (desired < h) {
+            level = GetLevel(stepper, desired);
+            if (level < stepper->levels[i]) level = stepper->levels[i];
+        }
+        else if (level > 0 && desired >= 2.0 * h && time % (2 * GetLevelTicks(stepper, level)) == 0) {
+            level--;
+        }
+        stepper->levels[i] = level;
+    }
+}
+
+void StepBodySystemBlock(BodySystem* system, BlockStepper* stepper, Real dt)
+{
+    PROFILE_BEGIN(PROFILE_STEP);
+    if (!stepper->valid || stepper->dt != dt) StartBlockSteps(system, stepper, dt);
+
+    const int count = stepper->count;
+    const long long end = GetLevelTicks(stepper, 0);
+    const double tick = (double)dt / (double)end;
+
+    long long time = 0;
+    while (time < end) {
+        long long next = end;
+        for (int i = 0; i < count; i++) {
+            const long long due = stepper->times[i] + GetLevelTicks(stepper, stepper->levels[i]);
+            if (due < next) next = due;
+        }
+
+        int activeCount = 0;
+        for (int i = 0; i < count; i++) {
+            if (stepper->times[i] + GetLevelTicks(stepper, stepper->levels[i]) == next) stepper->active[activeCount++] = i;
+        }
+
+        PredictBodies(stepper, next, tick);
+        EvaluateActiveForces(system, stepper, activeCount);
+        CorrectActiveBodies(stepper, activeCount, next, tick);
+        stepper->blockSteps++;
+        time = next;
+    }
+
+    // Every body is at the end of dt, which is the start of the next one
+    for (int i = 0; i < count; i++) stepper->times[i] = 0;
+    for (int i = 0; i < 4 * count; i++) system->state[i] = (Real)stepper->state[i];
+    system->accelerationsValid = 0;
+    PROFILE_END(PROFILE_STEP);
+}
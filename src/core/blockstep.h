@@ -0,0 +1,54 @@
+#ifndef GABRK_BLOCKSTEP_H
+#define GABRK_BLOCKSTEP_H
+
+#include "arena.h"
+#include "bodies.h"
+#include "precision.h"
+
+#define BLOCKSTEP_MAX_LEVEL 40
+
+// Hierarchical block time steps with the fourth-order Hermite scheme (Makino and Aarseth
+// 1992). Each body steps at dt / 2^level, with the level chosen from its acceleration and
+// its derivatives, so a tight binary takes short steps without forcing them on the rest
+// of the system. At each block time only the bodies that are due get new forces, summed
+// directly over every body predicted to that time. Levels only rise again at times that
+// are multiples of the longer step, so all bodies meet again at the end of every dt.
+typedef struct {
+    int count;
+    int maxLevel;         // The shortest step is dt / 2^maxLevel
+    Real eta;             // Accuracy parameter of the Aarseth step criterion
+    Real dt;              // The step the levels divide, from the last StepBodySystemBlock
+    int valid;            // The caches and levels describe the system's current state
+
+    // Per-body caches in one arena: the state (px, py, vx, vy), acceleration and jerk (x
+    // blocks, then y) at each body's own time, that time in ticks of dt / 2^maxLevel, and
+    // the level. They are double in every precision, since the corrector divides
+    // differences of accelerations by up to h^3 and float values would leave only
+    // rounding noise; the system's state receives a copy at the end of every dt.
+    Arena workspace;
+    double* state;
+    double* accelerations;
+    double* jerks;
+    long long* times;
+    int* levels;
+    double* predicted;    // px, py, vx, vy of every body at the current block time
+    int* active;
+    double* forces;       // ax, ay, jx, jy of each active body
+
+    long long blockSteps;
+    long long bodyForces; // Bodies whose forces were summed, over all block steps
+} BlockStepper;
+
+// eta 0 uses the usual 0.02. Returns a stepper with count 0 on failure.
+BlockStepper LoadBlockStepper(int count, int maxLevel, Real eta);
+void UnloadBlockStepper(BlockStepper stepper);
+
+// Must be called whenever the system's state is changed outside StepBodySystemBlock
+static inline void ResetBlockStepper(BlockStepper* stepper) { stepper->valid = 0; }
+
+// Advances every body by exactly dt in block steps. Forces are direct sums whatever the
+// system's force solver, split across its pool by active body; the first step, and the
+// first after a reset or a change of dt, evaluates every body to pick the levels.
+void StepBodySystemBlock(BodySystem* system, BlockStepper* stepper, Real dt);
+
+#endif
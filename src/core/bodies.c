@@ -0,0 +1,282 @@
+#include "bodies.h"
+#include "allocator.h"
+#include "barneshut.h"
+#include "gravity.h"
+#include "profiler.h"
+#include "symplectic.h"
+
+#include <tgmath.h>
+#include <string.h>
+
+const char* forceSolverNames[FORCE_SOLVER_COUNT] = {
+    "Direct",
+    "Barnes-Hut",
+    "Cutoff",
+};
+
+BodySystem LoadBodySystem(int count)
+{
+    BodySystem system = { 0 };
+    const int dim = 4 * count;
+
+    // Everything the steppers touch per step comes from one arena and the cell grid, both
+    // sized here, so stepping never allocates. Only the Barnes-Hut tree grows, during the
+    // first builds.
+    const int forceBuffers = (sizeof(ForceReal) != sizeof(Real)) ? 2 : 0;
+    const size_t sortElement = (sizeof(Real) > sizeof(int)) ? sizeof(Real) : sizeof(int);
+    const size_t workspaceSize = GetArenaPushSize(GetRKScratchSize(dim) * sizeof(Real)) +
+                                 GetArenaPushSize((dim / 2) * sizeof(Real)) +
+                                 GetArenaPushSize(count * sizeof(ForceReal)) +
+                                 forceBuffers * GetArenaPushSize((dim / 2) * sizeof(ForceReal)) +
+                                 GetArenaPushSize(2 * count * sizeof(uint32_t)) +
+                                 GetArenaPushSize(2 * count * sizeof(int)) +
+                                 GetArenaPushSize(count * sortElement);
+
+    system.state = CoreCalloc(dim, sizeof(Real));
+    system.mass = CoreCalloc(count, sizeof(ForceReal));
+    system.ids = CoreAlloc(count * sizeof(int));
+    system.workspace = LoadArena(workspaceSize);
+    system.grid = LoadCellGrid(count);
+    if (!system.state || !system.mass || !system.ids || !system.workspace.base || !system.grid.cellStart) {
+        UnloadBodySystem(system);
+        return (BodySystem){ 0 };
+    }
+
+    system.scratch = PushArena(&system.workspace, GetRKScratchSize(dim) * sizeof(Real));
+    system.accelerations = PushArena(&system.workspace, (dim / 2) * sizeof(Real));
+    system.potentials = PushArena(&system.workspace, count * sizeof(ForceReal));
+    if (forceBuffers) {
+        system.forcePositions = PushArena(&system.workspace, (dim / 2) * sizeof(ForceReal));
+        system.forceAccelerations = PushArena(&system.workspace, (dim / 2) * sizeof(ForceReal));
+    }
+    system.sortKeys = PushArena(&system.workspace, 2 * count * sizeof(uint32_t));
+    system.sortIndices = PushArena(&system.workspace, 2 * count * sizeof(int));
+    system.sortBuffer = PushArena(&system.workspace, count * sortElement);
+    for (int i = 0; i < count; i++) system.ids[i] = i;
+
+    system.count = count;
+    system.forceSolver = FORCE_DIRECT;
+    system.theta = 0.5f;
+    system.cutoff = 50.0f;
+    system.px = system.state;
+    system.py = system.state + count;
+    system.vx = system.state + 2 * count;
+    system.vy = system.state + 3 * count;
+    return system;
+}
+
+void UnloadBodySystem(BodySystem system)
+{
+    CoreFree(system.state);
+    CoreFree(system.mass);
+    CoreFree(system.ids);
+    UnloadArena(system.workspace);
+    UnloadQuadTree(system.tree);
+    UnloadCellGrid(system.grid);
+}
+
+void CopyBodiesById(const BodySystem* system, Real* state, ForceReal* mass)
+{
+    const int count = system->count;
+    for (int block = 0; block < 4; block++) {
+        const Real* source = system->state + block * count;
+        Real* target = state + block * count;
+        for (int i = 0; i < count; i++) target[system->ids[i]] = source[i];
+    }
+    if (mass) {
+        for (int i = 0; i < count; i++) mass[system->ids[i]] = system->mass[i];
+    }
+}
+
+typedef struct {
+    const BodySystem* system;
+    const ForceReal* positions;
+    ForceReal* accelerations;
+    ForceReal* potentials;
+    int count;
+    ForceSolver solver; // FORCE_DIRECT when the solver's structure could not be built
+} AccelerationJob;
+
+static void AccelerationRange(int begin, int end, void* user)
+{
+    const AccelerationJob* job = user;
+    const BodySystem* system = job->system;
+    const int count = job->count;
+    const ForceReal* px = job->positions;
+    const ForceReal* py = job->positions + count;
+    ForceReal* ax = job->accelerations;
+    ForceReal* ay = job->accelerations + count;
+
+    switch (job->solver)
+    {
+        case FORCE_DIRECT: ComputeAccelerationsRange(px, py, system->mass, count, begin, end, ax, ay, job->potentials); break;
+        case FORCE_BARNES_HUT: EvaluateBarnesHutRange(&system->tree, px, py, system->mass, begin, end, system->theta, ax, ay, job->potentials); break;
+        case FORCE_CUTOFF: EvaluateCutoffRange(&system->grid, begin, end, system->cutoff, ax, ay, job->potentials); break;
+        default: break;
+    }
+}
+
+static void ComputeForces(BodySystem* system, const ForceReal* positions, ForceReal* accelerations, int count)
+{
+    const ForceReal* px = positions;
+    const ForceReal* py = positions + count;
+    ForceReal* ax = accelerations;
+    ForceReal* ay = accelerations + count;
+    ForceReal* potentials = system->potentialRequested ? system->potentials : NULL;
+
+    // A solver whose structure cannot be built falls back to direct summation, so the
+    // accelerations are always written
+    if (system->pool) {
+        int built = 1;
+        if (system->forceSolver == FORCE_BARNES_HUT) built = BuildQuadTree(&system->tree, px, py, system->mass, count);
+        if (system->forceSolver == FORCE_CUTOFF) built = BuildCellGrid(&system->grid, px, py, system->mass, count, system->cutoff);
+        if (!built) system->forceFallbacks++;
+
+        AccelerationJob job = { system, positions, accelerations, potentials, count, built ? system->forceSolver : FORCE_DIRECT };
+        ParallelFor(system->pool, count, AccelerationRange, &job);
+        return;
+    }
+
+    int built = 1;
+    switch (system->forceSolver)
+    {
+        case FORCE_DIRECT: ComputeAccelerations(px, py, system->mass, count, ax, ay, potentials); break;
+        case FORCE_BARNES_HUT: built = ComputeAccelerationsBarnesHut(&system->tree, px, py, system->mass, count, system->theta, ax, ay, potentials); break;
+        case FORCE_CUTOFF: built = ComputeAccelerationsCutoff(&system->grid, px, py, system->mass, count, system->cutoff, ax, ay, potentials); break;
+        default: break;
+    }
+    if (!built) {
+        system->forceFallbacks++;
+        ComputeAccelerations(px, py, system->mass, count, ax, ay, potentials);
+    }
+}
+
+static void EvaluateForces(BodySystem* system, const Real* positions, Real* accelerations, int halfDim)
+{
+    PROFILE_BEGIN(PROFILE_FORCES);
+    system->potentialValid = system->potentialRequested;
+
+#if defined(GABRK_PRECISION_MIXED)
+    for (int i = 0; i < halfDim; i++) system->forcePositions[i] = (ForceReal)positions[i];
+    ComputeForces(system, system->forcePositions, system->forceAccelerations, halfDim / 2);
+    for (int i = 0; i < halfDim; i++) accelerations[i] = system->forceAccelerations[i];
+#else
+    ComputeForces(system, positions, accelerations, halfDim / 2);
+#endif
+    PROFILE_END(PROFILE_FORCES);
+}
+
+void BodyAcceleration(const Real* positions, Real* accelerations, int halfDim, void* user)
+{
+    BodySystem* system = user;
+    system->forceEvaluations++;
+    EvaluateForces(system, positions, accelerations, halfDim);
+}
+
+void BodyDerivative(const Real* state, Real* derivative, int dim, void* user)
+{
+    // d(position)/dt is the velocity block of the same state
+    memcpy(derivative, state + dim / 2, (dim / 2) * sizeof(Real));
+    BodyAcceleration(state, derivative + dim / 2, dim / 2, user);
+}
+
+void EvaluateBodyPotentials(BodySystem* system)
+{
+    const int requested = system->potentialRequested;
+    system->potentialRequested = 1;
+    EvaluateForces(system, system->state, system->accelerations, GetBodySystemDim(system) / 2);
+    system->potentialRequested = requested;
+    system->accelerationsValid = 1;
+}
+
+void StepBodySystem(BodySystem* system, Method method, Real dt)
+{
+    PROFILE_BEGIN_STEP(system);
+    const int dim = GetBodySystemDim(system);
+
+    if (IsSymplecticMethod(method)) {
+        StepSymplectic(method, system->state, system->state + dim / 2, dim / 2, dt, BodyAcceleration, system,
+                       system->accelerations, &system->accelerationsValid);
+    }
+    else {
+        StepRKParallel(method, system->state, dim, dt, BodyDerivative, system, system->scratch, system->pool);
+        system->accelerationsValid = 0;
+    }
+    PROFILE_END_STEP(system, method);
+}
+
+void ResetTwoBodyOrbit(BodySystem* system)
+{
+    const Real centerX = 400.0;
+    const Real centerY = 300.0;
+
+    system->px[0] = centerX - 100; system->py[0] = centerY; system->mass[0] = 10.0f;
+    system->px[1] = centerX + 100; system->py[1] = centerY; system->mass[1] = 10.0f;
+
+    const Real distance = sqrt(pow(system->px[1] - system->px[0], 2) + pow(system->py[1] - system->py[0], 2));
+    const Real orbitalSpeed = sqrt(GRAVITY_G * (system->mass[0] + system->mass[1]) / distance);
+
+    system->vx[0] = 0; system->vy[0] = -orbitalSpeed * (system->mass[1] / (system->mass[0] + system->mass[1]));
+    system->vx[1] = 0; system->vy[1] = orbitalSpeed * (system->mass[0] / (system->mass[0] + system->mass[1]));
+
+    system->accelerationsValid = 0;
+}
+
+Real StepBodySystemAdaptive(BodySystem* system, Method method, AdaptiveController* controller)
+{
+    PROFILE_BEGIN_STEP(system);
+    system->accelerationsValid = 0;
+    const Real dt = StepRKAdaptive(method, system->state, GetBodySystemDim(system), BodyDerivative, system,
+                                   system->scratch, controller);
+    PROFILE_END_STEP(system, method);
+    return dt;
+}
+
+int AdvanceBodySystemAdaptive(BodySystem* system, Method method, AdaptiveController* controller, Real duration)
+{
+    PROFILE_BEGIN_STEP(system);
+    system->accelerationsValid = 0;
+    const int steps = IntegrateRKAdaptive(method, system->state, GetBodySystemDim(system), duration, BodyDerivative,
+                                          system, system->scratch, controller);
+    PROFILE_END_STEP(system, method);
+    return steps;
+}
+
+double ComputeKineticEnergy(const BodySystem* system)
+{
+    double energy = 0.0;
+    for (int i = 0; i < system->count; i++) {
+        const double speedSquared = (double)system->vx[i] * system->vx[i] + (double)system->vy[i] * system->vy[i];
+        energy += 0.5 * system->mass[i] * speedSquared;
+    }
+    return energy;
+}
+
+double ComputePotentialEnergy(const BodySystem* system)
+{
+    const double eps2 = (double)GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+
+    double energy = 0.0;
+    for (int i = 0; i < system->count; i++) {
+        for (int j = i + 1; j < system->count; j++) {
+            const double dx = (double)system->px[j] - system->px[i];
+            const double dy = (double)system->py[j] - system->py[i];
+            if (system->forceSolver == FORCE_CUTOFF) {
+                energy += (double)system->mass[i] * GetCutoffPairPotential(system->mass[j], dx * dx + dy * dy, system->cutoff);
+                continue;
+            }
+            const double distance = sqrt(dx * dx + dy * dy + eps2);
+            energy -= (GRAVITY_G * (double)system->mass[i] * system->mass[j]) / distance;
+        }
+    }
+    return energy;
+}
+
+double ComputeAngularMomentum(const BodySystem* system)
+{
+    double momentum = 0.0;
+    for (int i = 0; i < system->count; i++) {
+        momentum += system->mass[i] * ((double)system->px[i] * system->vy[i] - (double)system->py[i] * system->vx[i]);
+    }
+    return momentum;
+}
@@ -0,0 +1,113 @@
+#ifndef GABRK_BODIES_H
+#define GABRK_BODIES_H
+
+#include "arena.h"
+#include "barneshut.h"
+#include "cellgrid.h"
+#include "methods.h"
+#include "precision.h"
+#include "rk.h"
+#include "threadpool.h"
+
+#include <stdint.h>
+
+typedef enum {
+    FORCE_DIRECT,
+    FORCE_BARNES_HUT,
+    FORCE_CUTOFF, // Short-range pairs within cutoff only, from a cell list (cellgrid.h)
+
+    FORCE_SOLVER_COUNT
+} ForceSolver;
+
+extern const char* forceSolverNames[FORCE_SOLVER_COUNT];
+
+// N-body system in structure-of-arrays layout. px, py, vx and vy are consecutive
+// blocks of one flat state array, which is what the RK stepper integrates.
+typedef struct {
+    int count;
+    Real* state;
+    Real* px;
+    Real* py;
+    Real* vx;
+    Real* vy;
+    ForceReal* mass;
+
+    // Original index of the body now at each position. SortBodySystem (spatialsort.h)
+    // reorders the bodies for locality and permutes ids with them, so output can follow
+    // each body through any number of sorts.
+    int* ids;
+
+    // Per-step buffers, all carved from workspace when the system is loaded
+    Arena workspace;
+    Real* scratch;
+    uint32_t* sortKeys;      // Two key arrays, an index array pair and a staging array for SortBodySystem
+    int* sortIndices;
+    void* sortBuffer;
+
+    // Accelerations of the current positions (ax block, then ay), reused by the next
+    // symplectic step. Anything that edits positions must clear accelerationsValid.
+    Real* accelerations;
+    int accelerationsValid;
+
+    // Per-body potentials from the force kernels. Forces fill them while potentialRequested
+    // is set, and they describe the current positions while both potentialValid and
+    // accelerationsValid are set, so diagnostics after a symplectic step need no extra pass.
+    ForceReal* potentials;
+    int potentialRequested;
+    int potentialValid;
+
+    // Narrowed copies of positions and accelerations for the force solvers when
+    // ForceReal differs from Real (mixed precision), NULL otherwise
+    ForceReal* forcePositions;
+    ForceReal* forceAccelerations;
+
+    ForceSolver forceSolver;
+    ForceReal theta; // Barnes-Hut opening angle
+    QuadTree tree;
+    ForceReal cutoff; // Interaction range of FORCE_CUTOFF
+    CellGrid grid;
+
+    // Optional, not owned. When set, forces use the gather kernels split by body range
+    // so the result is identical for every pool size, including a single thread.
+    ThreadPool* pool;
+
+    long long forceEvaluations; // Incremented once per BodyDerivative call
+    long long forceFallbacks;   // Force evaluations summed directly because the tree or cell grid could not be built
+} BodySystem;
+
+BodySystem LoadBodySystem(int count);
+void UnloadBodySystem(BodySystem system);
+
+static inline int GetBodySystemDim(const BodySystem* system) { return 4 * system->count; }
+
+// Copies the state blocks and, unless NULL, the masses with every body at its original
+// index, undoing any spatial sorting; state receives dim values
+void CopyBodiesById(const BodySystem* system, Real* state, ForceReal* mass);
+
+// AccelerationFn and DerivativeFn for a BodySystem passed as user data
+void BodyAcceleration(const Real* positions, Real* accelerations, int halfDim, void* user);
+void BodyDerivative(const Real* state, Real* derivative, int dim, void* user);
+
+// Fills the acceleration cache and the potentials for the current positions. Not counted
+// in forceEvaluations, which tracks the integrator's own work.
+void EvaluateBodyPotentials(BodySystem* system);
+
+// Two equal masses on a circular orbit around (400, 300), the viewer's default scene
+void ResetTwoBodyOrbit(BodySystem* system);
+
+// Runs either a Runge-Kutta step or a symplectic step, depending on the method
+void StepBodySystem(BodySystem* system, Method method, Real dt);
+
+// Adaptive stepping for embedded methods. The controller's cached first stage lives in
+// the system's scratch buffer, so reset the controller after any other kind of step or
+// after editing the state.
+Real StepBodySystemAdaptive(BodySystem* system, Method method, AdaptiveController* controller);
+int AdvanceBodySystemAdaptive(BodySystem* system, Method method, AdaptiveController* controller, Real duration);
+
+// Plain double references for the compensated, cached sums of diagnostics.h; these always
+// take the O(n^2) pair sum for the potential, of the shifted short-range pairs for FORCE_CUTOFF
+double ComputeKineticEnergy(const BodySystem* system);
+double ComputePotentialEnergy(const BodySystem* system);
+double ComputeAngularMomentum(const BodySystem* system); // About the origin
+
+#endif
@@ -0,0 +1,199 @@
+#include "cellgrid.h"
+#include "allocator.h"
+#include "gravity.h"
+#include "profiler.h"
+
+#include <string.h>
+#include <tgmath.h>
+
+CellGrid LoadCellGrid(int count)
+{
+    CellGrid grid = { 0 };
+    if (count <= 0) return grid;
+
+    const int cells = CELLGRID_CELLS_PER_BODY * count;
+    grid.cellStart = CoreAlloc((cells + 1) * sizeof(int));
+    grid.order = CoreAlloc(count * sizeof(int));
+    grid.cellOf = CoreAlloc(count * sizeof(int));
+    grid.sortedX = CoreAlloc(count * sizeof(ForceReal));
+    grid.sortedY = CoreAlloc(count * sizeof(ForceReal));
+    grid.sortedMass = CoreAlloc(count * sizeof(ForceReal));
+    if (!grid.cellStart || !grid.order || !grid.cellOf || !grid.sortedX || !grid.sortedY || !grid.sortedMass) {
+        UnloadCellGrid(grid);
+        return (CellGrid){ 0 };
+    }
+
+    grid.cellCapacity = cells + 1;
+    grid.bodyCapacity = count;
+    return grid;
+}
+
+void UnloadCellGrid(CellGrid grid)
+{
+    CoreFree(grid.cellStart);
+    CoreFree(grid.order);
+    CoreFree(grid.cellOf);
+    CoreFree(grid.sortedX);
+    CoreFree(grid.sortedY);
+    CoreFree(grid.sortedMass);
+}
+
+// Positions outside the grid, including NaN, land in the nearest edge cell
+static int CellCoordinate(ForceReal position, ForceReal origin, ForceReal cellSize, int cells)
+{
+    const ForceReal cell = (position - origin) / cellSize;
+    if (cell >= 0.0f && cell < (ForceReal)cells) return (int)cell;
+    return (cell >= (ForceReal)cells) ? cells - 1 : 0;
+}
+
+// Cells start one cutoff wide, which must be positive, and double until the bounding box needs at most
+// CELLGRID_CELLS_PER_BODY cells per body, so a stray body cannot blow up the grid
+static void FitGrid(CellGrid* grid, const ForceReal* px, const ForceReal* py, int count, ForceReal cutoff)
+{
+    ForceReal minX = px[0], maxX = px[0];
+    ForceReal minY = py[0], maxY = py[0];
+    for (int i = 1; i < count; i++) {
+        minX = fmin(minX, px[i]);
+        maxX = fmax(maxX, px[i]);
+        minY = fmin(minY, py[i]);
+        maxY = fmax(maxY, py[i]);
+    }
+
+    const double width = (double)maxX - minX;
+    const double height = (double)maxY - minY;
+    const double maxCells = (double)CELLGRID_CELLS_PER_BODY * count;
+    double cellSize = cutoff;
+
+    grid->originX = minX;
+    grid->originY = minY;
+    grid->columns = 1;
+    grid->rows = 1;
+    if (!isfinite(width) || !isfinite(height)) {
+        grid->cellSize = (ForceReal)cellSize;
+        return;
+    }
+
+    while ((floor(width / cellSize) + 1.0) * (floor(height / cellSize) + 1.0) > maxCells) cellSize *= 2.0;
+    grid->cellSize = (ForceReal)cellSize;
+    grid->columns = (int)floor(width / cellSize) + 1;
+    grid->rows = (int)floor(height / cellSize) + 1;
+}
+
+static int BuildGrid(CellGrid* grid, const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count, ForceReal cutoff)
+{
+    grid->count = 0;
+    if (!(cutoff > 0.0f) || !isfinite(cutoff)) return 0;
+    if (count <= 0) return 1;
+    if (count > grid->bodyCapacity) return 0;
+
+    FitGrid(grid, px, py, count, cutoff);
+    const int cells = grid->columns * grid->rows;
+    if (cells + 1 > grid->cellCapacity) return 0;
+
+    // Counting sort: count bodies per cell, turn the counts into offsets, then scatter.
+    // The scatter keeps the original order within a cell, so the sort is stable.
+    int* cellStart = grid->cellStart;
+    memset(cellStart, 0, (cells + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        const int cx = CellCoordinate(px[i], grid->originX, grid->cellSize, grid->columns);
+        const int cy = CellCoordinate(py[i], grid->originY, grid->cellSize, grid->rows);
+        grid->cellOf[i] = cy * grid->columns + cx;
+        cellStart[grid->cellOf[i] + 1]++;
+    }
+    for (int c = 0; c < cells; c++) cellStart[c + 1] += cellStart[c];
+
+    for (int i = 0; i < count; i++) {
+        const int slot = cellStart[grid->cellOf[i]]++;
+        grid->order[slot] = i;
+        grid->sortedX[slot] = px[i];
+        grid->sortedY[slot] = py[i];
+        grid->sortedMass[slot] = mass[i];
+    }
+
+    // The scatter advanced every offset to the start of the next cell; shift them back
+    for (int c = cells; c > 0; c--) cellStart[c] = cellStart[c - 1];
+    cellStart[0] = 0;
+
+    grid->count = count;
+    return 1;
+}
+
+int BuildCellGrid(CellGrid* grid, const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count, ForceReal cutoff)
+{
+    PROFILE_BEGIN(PROFILE_TREE_BUILD);
+    const int built = BuildGrid(grid, px, py, mass, count, cutoff);
+    PROFILE_END(PROFILE_TREE_BUILD);
+    return built;
+}
+
+void EvaluateCutoffRange(const CellGrid* grid, int begin, int end, ForceReal cutoff, ForceReal* ax, ForceReal* ay,
+                         ForceReal* potential)
+{
+    if (grid->count == 0) return;
+
+    const ForceReal eps2 = GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+    const ForceReal cutoff2 = cutoff * cutoff;
+    const ForceReal cutoffInvDistance = 1.0f / sqrt(cutoff2 + eps2);
+    const ForceReal forceShift = cutoff * cutoffInvDistance * cutoffInvDistance * cutoffInvDistance;
+    const int columns = grid->columns;
+
+    for (int s = begin; s < end; s++) {
+        const int body = grid->order[s];
+        const int cell = grid->cellOf[body];
+        const int cx = cell % columns;
+        const int cy = cell / columns;
+        const ForceReal xi = grid->sortedX[s];
+        const ForceReal yi = grid->sortedY[s];
+        ForceReal axi = 0.0f;
+        ForceReal ayi = 0.0f;
+        ForceReal phii = 0.0f;
+
+        // The three neighbouring cells of a row are consecutive, so each row is one run of sorted bodies
+        const int firstColumn = (cx > 0) ? cx - 1 : 0;
+        const int lastColumn = (cx + 1 < columns) ? cx + 1 : columns - 1;
+        const int firstRow = (cy > 0) ? cy - 1 : 0;
+        const int lastRow = (cy + 1 < grid->rows) ? cy + 1 : grid->rows - 1;
+
+        for (int row = firstRow; row <= lastRow; row++) {
+            const int runBegin = grid->cellStart[row * columns + firstColumn];
+            const int runEnd = grid->cellStart[row * columns + lastColumn + 1];
+
+            for (int t = runBegin; t < runEnd; t++) {
+                const ForceReal dx = grid->sortedX[t] - xi;
+                const ForceReal dy = grid->sortedY[t] - yi;
+                const ForceReal distanceSquared = dx * dx + dy * dy;
+                if (distanceSquared >= cutoff2 || t == s) continue;
+
+                const ForceReal distance = sqrt(distanceSquared);
+                const ForceReal invDistance = 1.0f / sqrt(distanceSquared + eps2);
+                const ForceReal shift = (distance > 0.0f) ? forceShift / distance : 0.0f;
+                const ForceReal scale = GRAVITY_G * grid->sortedMass[t] * (invDistance * invDistance * invDistance - shift);
+                axi += dx * scale;
+                ayi += dy * scale;
+                phii += grid->sortedMass[t] * (invDistance - cutoffInvDistance + (distance - cutoff) * forceShift);
+            }
+        }
+
+        ax[body] = axi;
+        ay[body] = ayi;
+        if (potential) potential[body] = -GRAVITY_G * phii;
+    }
+}
+
+int ComputeAccelerationsCutoff(CellGrid* grid, const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                               ForceReal cutoff, ForceReal* ax, ForceReal* ay, ForceReal* potential)
+{
+    if (!BuildCellGrid(grid, px, py, mass, count, cutoff)) return 0;
+    EvaluateCutoffRange(grid, 0, count, cutoff, ax, ay, potential);
+    return 1;
+}
+
+double GetCutoffPairPotential(double m, double r2, double cutoff)
+{
+    const double eps2 = (double)GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+    if (r2 >= cutoff * cutoff) return 0.0;
+
+    const double cutoffInvDistance = 1.0 / sqrt(cutoff * cutoff + eps2);
+    const double forceShift = cutoff * cutoffInvDistance * cutoffInvDistance * cutoffInvDistance;
+    return -GRAVITY_G * m * (1.0 / sqrt(r2 + eps2) - cutoffInvDistance + (sqrt(r2) - cutoff) * forceShift);
+}
@@ -0,0 +1,55 @@
+#ifndef GABRK_CELLGRID_H
+#define GABRK_CELLGRID_H
+
+#include "precision.h"
+
+#define CELLGRID_CELLS_PER_BODY 4 // Cells grow past the cutoff when the bounding box would need more than this
+
+// Uniform grid over the bodies' bounding box with cells at least one cutoff wide, so every
+// partner within the cutoff lies in the 3x3 block of cells around a body. The build is a
+// counting sort: bodies are copied into cell order, and the force loops then stream
+// through contiguous memory instead of chasing indices. The cell count is capped at
+// CELLGRID_CELLS_PER_BODY per body, so every array is sized once by LoadCellGrid and
+// rebuilds never allocate.
+typedef struct {
+    int columns;
+    int rows;
+    ForceReal originX, originY;
+    ForceReal cellSize;
+    int* cellStart;     // columns * rows + 1 offsets into the sorted arrays
+    int cellCapacity;
+    int* order;         // Body at each sorted position
+    int* cellOf;        // Cell of each body, kept between the two passes of the sort
+    ForceReal* sortedX;
+    ForceReal* sortedY;
+    ForceReal* sortedMass;
+    int bodyCapacity;
+    int count;
+} CellGrid;
+
+// Grid for up to count bodies; capacities are 0 if the arrays could not be allocated
+CellGrid LoadCellGrid(int count);
+void UnloadCellGrid(CellGrid grid);
+
+// Returns 0 if count exceeds the grid's capacity or cutoff is not positive and finite
+int BuildCellGrid(CellGrid* grid, const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count, ForceReal cutoff);
+
+// Short-range gravity, shifted so that force and potential both fall smoothly to zero at
+// the cutoff: each pair closer than cutoff adds G m d (1 / (r^2 + eps^2)^(3/2) - s / r)
+// with s = cutoff / (cutoff^2 + eps^2)^(3/2). Evaluates the bodies at sorted positions
+// [begin, end) of a grid built from the same positions; each body gathers its own sum in
+// a fixed order, so disjoint ranges can run concurrently and any split gives the same
+// result. ax, ay and potential (unless NULL) are indexed by body, not by sorted position.
+void EvaluateCutoffRange(const CellGrid* grid, int begin, int end, ForceReal cutoff, ForceReal* ax, ForceReal* ay,
+                         ForceReal* potential);
+
+// Rebuilds the grid and evaluates every body. Returns 0, leaving ax and ay untouched, if
+// the grid could not be built.
+int ComputeAccelerationsCutoff(CellGrid* grid, const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                               ForceReal cutoff, ForceReal* ax, ForceReal* ay, ForceReal* potential);
+
+// Shifted pair potential -G m (1 / sqrt(r^2 + eps^2) - 1 / sqrt(cutoff^2 + eps^2) + (r - cutoff) s)
+// of a unit mass at distance sqrt(r2) from mass m, zero beyond the cutoff; in double, for diagnostics
+double GetCutoffPairPotential(double m, double r2, double cutoff);
+
+#endif
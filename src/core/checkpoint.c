@@ -0,0 +1,381 @@
+#if !defined(_WIN32)
+    #define _POSIX_C_SOURCE 200809L // fileno, fsync
+#endif
+
+#include "checkpoint.h"
+#include "allocator.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#define CHECKPOINT_MAGIC "GABRKCKP"
+#define CHECKPOINT_VERSION 5
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t realSize;
+    uint32_t forceRealSize;
+    uint32_t count;
+    int32_t method;
+    int32_t forceSolver;
+    int32_t adaptive;
+    int32_t accelerationsValid;
+    int32_t sortEvery;
+    int32_t sortOrder;
+    double dt;
+    double theta;
+    double cutoff;
+    int64_t step;
+    int64_t forceEvaluations;
+    AdaptiveController controller;
+    Diagnostics initial;
+} CheckpointHeader;
+
+// Header, then state, masses, body ids, acceleration cache and first stage, then a
+// checksum of everything before it
+static size_t GetCheckpointSize(int count)
+{
+    return sizeof(CheckpointHeader) + 10 * (size_t)count * sizeof(Real) + count * (sizeof(ForceReal) + sizeof(int32_t)) +
+           sizeof(uint64_t);
+}
+
+// FNV-1a, to reject files that are torn or corrupted rather than restore garbage
+static uint64_t Checksum(const unsigned char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) hash = (hash ^ data[i]) * 1099511628211ull;
+    return hash;
+}
+
+static void SerializeCheckpoint(unsigned char* buffer, const BodySystem* system, const CheckpointRun* run)
+{
+    const int count = system->count;
+    const int dim = GetBodySystemDim(system);
+    const int firstStageValid = run->adaptive && run->controller.firstStageValid;
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header)); // Padding too, so no stack garbage reaches the file
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.realSize = sizeof(Real);
+    header.forceRealSize = sizeof(ForceReal);
+    header.count = (uint32_t)count;
+    header.method = run->method;
+    header.forceSolver = system->forceSolver;
+    header.adaptive = run->adaptive;
+    header.accelerationsValid = system->accelerationsValid;
+    header.sortEvery = run->sortEvery;
+    header.sortOrder = run->sortOrder;
+    header.dt = run->dt;
+    header.theta = system->theta;
+    header.cutoff = system->cutoff;
+    header.initial = run->initial;
+    header.step = run->step;
+    header.forceEvaluations = system->forceEvaluations;
+    if (run->adaptive) header.controller = run->controller;
+
+    unsigned char* cursor = buffer;
+    memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    memcpy(cursor, system->state, dim * sizeof(Real));
+    cursor += dim * sizeof(Real);
+    memcpy(cursor, system->mass, count * sizeof(ForceReal));
+    cursor += count * sizeof(ForceReal);
+    for (int i = 0; i < count; i++) {
+        const int32_t id = system->ids[i];
+        memcpy(cursor, &id, sizeof(id));
+        cursor += sizeof(id);
+    }
+
+    if (system->accelerationsValid) memcpy(cursor, system->accelerations, (dim / 2) * sizeof(Real));
+    else memset(cursor, 0, (dim / 2) * sizeof(Real));
+    cursor += (dim / 2) * sizeof(Real);
+
+    if (firstStageValid) memcpy(cursor, GetRKFirstStage(system->scratch, dim), dim * sizeof(Real));
+    else memset(cursor, 0, dim * sizeof(Real));
+    cursor += dim * sizeof(Real);
+
+    const uint64_t checksum = Checksum(buffer, (size_t)(cursor - buffer));
+    memcpy(cursor, &checksum, sizeof(checksum));
+}
+
+// Writes to tmpPath, forces it to disk, then renames it over path
+// directory holds path; its entry for the rename is synced too, so the new file survives a crash
+static bool WriteFileAtomic(const char* path, const char* tmpPath, const char* directory, const unsigned char* data, size_t size)
+{
+    FILE* file = fopen(tmpPath, "wb");
+    if (!file) return false;
+
+    bool ok = fwrite(data, 1, size, file) == size && fflush(file) == 0;
+#if defined(_WIN32)
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        remove(tmpPath);
+        return false;
+    }
+
+#if defined(_WIN32)
+    (void)directory;
+    return MoveFileExA(tmpPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(tmpPath, path) != 0) return false;
+
+    const int descriptor = open(directory, O_RDONLY);
+    if (descriptor < 0) return false;
+    ok = fsync(descriptor) == 0;
+    return (close(descriptor) == 0) && ok;
+#endif
+}
+
+static char* MakeTmpPath(const char* path)
+{
+    const size_t length = strlen(path);
+    char* tmpPath = CoreAlloc(length + 5);
+    if (tmpPath) {
+        memcpy(tmpPath, path, length);
+        memcpy(tmpPath + length, ".tmp", 5);
+    }
+    return tmpPath;
+}
+
+// Directory holding path, "." for a bare file name
+static char* MakeDirectoryPath(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    const size_t length = !slash ? 1 : (slash == path) ? 1 : (size_t)(slash - path);
+    char* directory = CoreAlloc(length + 1);
+    if (directory) {
+        memcpy(directory, slash ? path : ".", length);
+        directory[length] = '\0';
+    }
+    return directory;
+}
+
+bool WriteCheckpoint(const char* path, const BodySystem* system, const CheckpointRun* run)
+{
+    const size_t size = GetCheckpointSize(system->count);
+    unsigned char* buffer = CoreAlloc(size);
+    char* tmpPath = MakeTmpPath(path);
+    char* directory = MakeDirectoryPath(path);
+
+    bool ok = buffer && tmpPath && directory;
+    if (ok) {
+        SerializeCheckpoint(buffer, system, run);
+        ok = WriteFileAtomic(path, tmpPath, directory, buffer, size);
+    }
+
+    CoreFree(tmpPath);
+    CoreFree(directory);
+    CoreFree(buffer);
+    return ok;
+}
+
+bool LoadCheckpoint(const char* path, BodySystem* system, CheckpointRun* run)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    CheckpointHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == CHECKPOINT_VERSION && header.realSize == sizeof(Real) &&
+              header.forceRealSize == sizeof(ForceReal) && header.count > 0 && header.count <= (1u << 26) &&
+              header.method >= 0 && header.method < METHOD_COUNT && header.forceSolver >= 0 &&
+              header.forceSolver < FORCE_SOLVER_COUNT && header.sortEvery >= 0 && header.sortOrder >= 0 &&
+              header.sortOrder < SPATIAL_ORDER_COUNT;
+
+    const size_t size = ok ? GetCheckpointSize((int)header.count) : 0;
+    unsigned char* buffer = ok ? CoreAlloc(size) : NULL;
+    if (buffer) {
+        memcpy(buffer, &header, sizeof(header));
+        ok = fread(buffer + sizeof(header), 1, size - sizeof(header), file) == size - sizeof(header);
+    }
+    else {
+        ok = false;
+    }
+    fclose(file);
+
+    uint64_t checksum = 0;
+    if (ok) {
+        memcpy(&checksum, buffer + size - sizeof(checksum), sizeof(checksum));
+        ok = checksum == Checksum(buffer, size - sizeof(checksum));
+    }
+
+    BodySystem loaded = ok ? LoadBodySystem((int)header.count) : (BodySystem){ 0 };
+    if (loaded.count == 0) {
+        CoreFree(buffer);
+        return false;
+    }
+
+    const int count = loaded.count;
+    const int dim = GetBodySystemDim(&loaded);
+    const unsigned char* cursor = buffer + sizeof(header);
+    memcpy(loaded.state, cursor, dim * sizeof(Real));
+    cursor += dim * sizeof(Real);
+    memcpy(loaded.mass, cursor, count * sizeof(ForceReal));
+    cursor += count * sizeof(ForceReal);
+    for (int i = 0; i < count; i++) {
+        int32_t id;
+        memcpy(&id, cursor, sizeof(id));
+        loaded.ids[i] = id;
+        cursor += sizeof(id);
+    }
+    memcpy(loaded.accelerations, cursor, (dim / 2) * sizeof(Real));
+    cursor += (dim / 2) * sizeof(Real);
+    memcpy(GetRKFirstStage(loaded.scratch, dim), cursor, dim * sizeof(Real));
+
+    loaded.forceSolver = (ForceSolver)header.forceSolver;
+    loaded.theta = (ForceReal)header.theta;
+    loaded.cutoff = (ForceReal)header.cutoff;
+    loaded.accelerationsValid = header.accelerationsValid;
+    loaded.forceEvaluations = header.forceEvaluations;
+
+    run->method = (Method)header.method;
+    run->dt = header.dt;
+    run->step = header.step;
+    run->adaptive = header.adaptive;
+    run->controller = header.controller;
+    run->sortEvery = header.sortEvery;
+    run->sortOrder = (SpatialOrder)header.sortOrder;
+    run->initial = header.initial;
+
+    CoreFree(buffer);
+    *system = loaded;
+    return true;
+}
+
+struct CheckpointWriter {
+    char* path;
+    char* tmpPath;
+    char* directory;
+    int count;
+    size_t size;
+    unsigned char* buffers[2];
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t requested;
+    int pending; // Buffer waiting for the thread, -1 if none
+    int writing; // Buffer the thread is writing, -1 if none
+    int stop;
+    int failed;
+};
+
+static void* CheckpointWriterMain(void* arg)
+{
+    CheckpointWriter* writer = arg;
+
+    pthread_mutex_lock(&writer->mutex);
+    for (;;) {
+        while (writer->pending < 0 && !writer->stop) pthread_cond_wait(&writer->requested, &writer->mutex);
+        if (writer->pending < 0) break;
+
+        writer->writing = writer->pending;
+        writer->pending = -1;
+        pthread_mutex_unlock(&writer->mutex);
+
+        const bool ok = WriteFileAtomic(writer->path, writer->tmpPath, writer->directory, writer->buffers[writer->writing], writer->size);
+
+        pthread_mutex_lock(&writer->mutex);
+        if (!ok) writer->failed = 1;
+        writer->writing = -1;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+
+CheckpointWriter* CreateCheckpointWriter(const char* path, const BodySystem* system)
+{
+    CheckpointWriter* writer = CoreCalloc(1, sizeof(CheckpointWriter));
+    if (!writer) return NULL;
+
+    const size_t length = strlen(path);
+    writer->path = CoreAlloc(length + 1);
+    writer->tmpPath = MakeTmpPath(path);
+    writer->directory = MakeDirectoryPath(path);
+    writer->count = system->count;
+    writer->size = GetCheckpointSize(system->count);
+    writer->buffers[0] = CoreAlloc(writer->size);
+    writer->buffers[1] = CoreAlloc(writer->size);
+    writer->pending = -1;
+    writer->writing = -1;
+
+    bool ok = writer->path && writer->tmpPath && writer->directory && writer->buffers[0] && writer->buffers[1];
+    if (ok) {
+        memcpy(writer->path, path, length + 1);
+        pthread_mutex_init(&writer->mutex, NULL);
+        pthread_cond_init(&writer->requested, NULL);
+        ok = pthread_create(&writer->thread, NULL, CheckpointWriterMain, writer) == 0;
+        if (!ok) {
+            pthread_cond_destroy(&writer->requested);
+            pthread_mutex_destroy(&writer->mutex);
+        }
+    }
+
+    if (!ok) {
+        CoreFree(writer->path);
+        CoreFree(writer->tmpPath);
+        CoreFree(writer->directory);
+        CoreFree(writer->buffers[0]);
+        CoreFree(writer->buffers[1]);
+        CoreFree(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+void RequestCheckpoint(CheckpointWriter* writer, const BodySystem* system, const CheckpointRun* run)
+{
+    if (system->count != writer->count) return;
+
+    // Take back a checkpoint the thread has not started on, otherwise the buffer it is not writing
+    pthread_mutex_lock(&writer->mutex);
+    int buffer = writer->pending;
+    if (buffer < 0) buffer = (writer->writing == 0) ? 1 : 0;
+    writer->pending = -1;
+    pthread_mutex_unlock(&writer->mutex);
+
+    SerializeCheckpoint(writer->buffers[buffer], system, run);
+
+    pthread_mutex_lock(&writer->mutex);
+    writer->pending = buffer;
+    pthread_cond_signal(&writer->requested);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+bool CloseCheckpointWriter(CheckpointWriter* writer)
+{
+    if (!writer) return false;
+
+    pthread_mutex_lock(&writer->mutex);
+    writer->stop = 1;
+    pthread_cond_signal(&writer->requested);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+
+    const bool ok = !writer->failed;
+    pthread_cond_destroy(&writer->requested);
+    pthread_mutex_destroy(&writer->mutex);
+    CoreFree(writer->path);
+    CoreFree(writer->tmpPath);
+    CoreFree(writer->directory);
+    CoreFree(writer->buffers[0]);
+    CoreFree(writer->buffers[1]);
+    CoreFree(writer);
+    return ok;
+}
@@ -0,0 +1,49 @@
+#ifndef GABRK_CHECKPOINT_H
+#define GABRK_CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bodies.h"
+#include "diagnostics.h"
+#include "methods.h"
+#include "rk.h"
+#include "spatialsort.h"
+
+// Everything about a run besides the bodies that a restart needs
+typedef struct {
+    Method method;
+    double dt;
+    long long step;
+    int adaptive;                  // Whether controller is in use
+    AdaptiveController controller;
+    int sortEvery;                 // Steps between SortBodySystem calls, 0 for never
+    SpatialOrder sortOrder;
+    Diagnostics initial;           // So drifts stay relative to the original start
+} CheckpointRun;
+
+// A checkpoint stores the bodies bit for bit (state, masses, ids, force settings and the
+// symplectic and FSAL caches) together with the run, so stepping on from a restored
+// checkpoint gives exactly the results of never having stopped. It can only be
+// restored by a build with the same precision.
+bool WriteCheckpoint(const char* path, const BodySystem* system, const CheckpointRun* run);
+// Loads a new BodySystem into system; false if the file is missing, corrupt or from
+// another precision
+bool LoadCheckpoint(const char* path, BodySystem* system, CheckpointRun* run);
+
+// Writes checkpoints on a background thread. Each one goes to path.tmp and is renamed
+// over path once it is on disk, so path always holds a whole checkpoint, even if the
+// process dies mid-write.
+typedef struct CheckpointWriter CheckpointWriter;
+
+// Buffers are sized for the system, which must keep its body count
+CheckpointWriter* CreateCheckpointWriter(const char* path, const BodySystem* system);
+
+// Copies the system and run and returns without waiting for the disk. A checkpoint still
+// waiting for the writer when the next one is requested is replaced by it.
+void RequestCheckpoint(CheckpointWriter* writer, const BodySystem* system, const CheckpointRun* run);
+
+// Finishes the last requested checkpoint; false if any write failed
+bool CloseCheckpointWriter(CheckpointWriter* writer);
+
+#endif
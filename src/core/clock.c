@@ -0,0 +1,43 @@
+#if !defined(_WIN32)
+    #define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
+
+#include "clock.h"
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+double GetClockSeconds(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+long long GetClockNanoseconds(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    // Whole seconds and the remainder separately, so the product cannot overflow
+    const long long seconds = counter.QuadPart / frequency.QuadPart;
+    const long long remainder = counter.QuadPart % frequency.QuadPart;
+    return seconds * 1000000000ll + remainder * 1000000000ll / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+#endif
+}
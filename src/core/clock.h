@@ -0,0 +1,9 @@
+#ifndef GABRK_CLOCK_H
+#define GABRK_CLOCK_H
+
+// Monotonic time from an arbitrary origin, for measuring intervals. Unlike the calendar
+// clock it never jumps when the system time is set.
+double GetClockSeconds(void);
+long long GetClockNanoseconds(void);
+
+#endif
@@ -0,0 +1,92 @@
+#include "diagnostics.h"
+#include "profiler.h"
+
+#include <math.h>
+
+// Neumaier's variant of Kahan summation: the rounding error of every addition is kept in
+// compensation, so the sum stays accurate to a few ulps whatever the body count
+typedef struct {
+    double sum;
+    double compensation;
+} CompensatedSum;
+
+static inline void AddCompensated(CompensatedSum* total, double value)
+{
+    const double sum = total->sum + value;
+    if (fabs(total->sum) >= fabs(value)) total->compensation += (total->sum - sum) + value;
+    else total->compensation += (value - sum) + total->sum;
+    total->sum = sum;
+}
+
+static inline double GetCompensatedSum(const CompensatedSum* total) { return total->sum + total->compensation; }
+
+static double SumPotentialEnergy(BodySystem* system)
+{
+#if DIAGNOSTICS_KERNEL_POTENTIAL
+    if (!system->accelerationsValid || !system->potentialValid) EvaluateBodyPotentials(system);
+
+    CompensatedSum energy = { 0 };
+    for (int i = 0; i < system->count; i++) AddCompensated(&energy, 0.5 * system->mass[i] * system->potentials[i]);
+    return GetCompensatedSum(&energy);
+#else
+    return ComputePotentialEnergy(system);
+#endif
+}
+
+Diagnostics ComputeDiagnostics(BodySystem* system)
+{
+    PROFILE_BEGIN(PROFILE_DIAGNOSTICS);
+    CompensatedSum kinetic = { 0 };
+    CompensatedSum momentumX = { 0 };
+    CompensatedSum momentumY = { 0 };
+    CompensatedSum angular = { 0 };
+    CompensatedSum mass = { 0 };
+    CompensatedSum centerX = { 0 };
+    CompensatedSum centerY = { 0 };
+
+    for (int i = 0; i < system->count; i++) {
+        const double m = system->mass[i];
+        const double x = system->px[i];
+        const double y = system->py[i];
+        const double vx = system->vx[i];
+        const double vy = system->vy[i];
+
+        AddCompensated(&kinetic, 0.5 * m * (vx * vx + vy * vy));
+        AddCompensated(&momentumX, m * vx);
+        AddCompensated(&momentumY, m * vy);
+        AddCompensated(&angular, m * (x * vy - y * vx));
+        AddCompensated(&mass, m);
+        AddCompensated(&centerX, m * x);
+        AddCompensated(&centerY, m * y);
+    }
+
+    Diagnostics diagnostics = { 0 };
+    diagnostics.kineticEnergy = GetCompensatedSum(&kinetic);
+    diagnostics.potentialEnergy = SumPotentialEnergy(system);
+    diagnostics.totalEnergy = diagnostics.kineticEnergy + diagnostics.potentialEnergy;
+    diagnostics.momentumX = GetCompensatedSum(&momentumX);
+    diagnostics.momentumY = GetCompensatedSum(&momentumY);
+    diagnostics.angularMomentum = GetCompensatedSum(&angular);
+    diagnostics.mass = GetCompensatedSum(&mass);
+    if (diagnostics.mass != 0.0) {
+        diagnostics.centerX = GetCompensatedSum(&centerX) / diagnostics.mass;
+        diagnostics.centerY = GetCompensatedSum(&centerY) / diagnostics.mass;
+    }
+
+    PROFILE_END(PROFILE_DIAGNOSTICS);
+    return diagnostics;
+}
+
+double GetEnergyDrift(const Diagnostics* initial, const Diagnostics* current)
+{
+    if (initial->totalEnergy == 0.0) return current->totalEnergy; // Nothing to be relative to
+    return (current->totalEnergy - initial->totalEnergy) / initial->totalEnergy;
+}
+
+double GetCenterOfMassDrift(const Diagnostics* initial, const Diagnostics* current, double time)
+{
+    if (initial->mass == 0.0) return 0.0;
+    const double expectedX = initial->centerX + initial->momentumX / initial->mass * time;
+    const double expectedY = initial->centerY + initial->momentumY / initial->mass * time;
+    return hypot(current->centerX - expectedX, current->centerY - expectedY);
+}
@@ -0,0 +1,41 @@
+#ifndef GABRK_DIAGNOSTICS_H
+#define GABRK_DIAGNOSTICS_H
+
+#include "bodies.h"
+
+// Mixed precision sums the potential in double rather than taking it from the float
+// kernels, which would hide energy drifts below about 1e-7
+#if defined(GABRK_PRECISION_MIXED)
+    #define DIAGNOSTICS_KERNEL_POTENTIAL 0
+#else
+    #define DIAGNOSTICS_KERNEL_POTENTIAL 1
+#endif
+
+// Conserved quantities of a BodySystem, accumulated in double with compensated sums
+typedef struct {
+    double kineticEnergy;
+    double potentialEnergy;
+    double totalEnergy;
+    double momentumX;
+    double momentumY;
+    double angularMomentum; // About the origin
+    double mass;
+    double centerX;         // Centre of mass
+    double centerY;
+} Diagnostics;
+
+// The potential comes from the per-body potentials of the last force evaluation when they
+// describe the current positions (a symplectic step run with potentialRequested set), so
+// the cost is O(n). Otherwise it runs one force evaluation with potentials, which also
+// fills the acceleration cache for the next symplectic step. With Barnes-Hut the potential
+// has the same tree approximation as the forces.
+Diagnostics ComputeDiagnostics(BodySystem* system);
+
+// (E - E0) / E0, or the absolute drift E - E0 when E0 is 0 (a single body at rest)
+double GetEnergyDrift(const Diagnostics* initial, const Diagnostics* current);
+
+// Distance between the centre of mass and where the initial momentum should have carried
+// it after time; nonzero only through integration and force errors
+double GetCenterOfMassDrift(const Diagnostics* initial, const Diagnostics* current, double time);
+
+#endif
@@ -0,0 +1,193 @@
+#include "ensemble.h"
+#include "allocator.h"
+#include "gravity.h"
+#include "rk.h"
+#include "symplectic.h"
+
+#include <string.h>
+#include <tgmath.h>
+
+#define BLOCK_DIM (8 * ENSEMBLE_BLOCK_SIZE)
+
+Ensemble LoadEnsemble(int count, ThreadPool* pool)
+{
+    Ensemble ensemble = { 0 };
+    if (count <= 0) return ensemble;
+
+    const int blockCount = (count + ENSEMBLE_BLOCK_SIZE - 1) / ENSEMBLE_BLOCK_SIZE;
+    const int slotCount = GetThreadPoolSize(pool);
+    const int forceBuffers = (sizeof(ForceReal) != sizeof(Real)) ? 2 : 0;
+
+    const size_t slotSize = GetArenaPushSize(GetRKScratchSize(BLOCK_DIM) * sizeof(Real)) +
+                            forceBuffers * GetArenaPushSize((BLOCK_DIM / 2) * sizeof(ForceReal));
+    const size_t workspaceSize = 3 * GetArenaPushSize(slotCount * sizeof(void*)) + slotCount * slotSize;
+
+    ensemble.state = CoreCalloc((size_t)blockCount * BLOCK_DIM, sizeof(Real));
+    ensemble.mass = CoreCalloc((size_t)blockCount * 2 * ENSEMBLE_BLOCK_SIZE, sizeof(ForceReal));
+    ensemble.accelerations = CoreCalloc((size_t)blockCount * BLOCK_DIM / 2, sizeof(Real));
+    ensemble.workspace = LoadArena(workspaceSize);
+    if (!ensemble.state || !ensemble.mass || !ensemble.accelerations || !ensemble.workspace.base) {
+        UnloadEnsemble(ensemble);
+        return (Ensemble){ 0 };
+    }
+
+    ensemble.scratch = PushArena(&ensemble.workspace, slotCount * sizeof(Real*));
+    ensemble.forcePositions = PushArena(&ensemble.workspace, slotCount * sizeof(ForceReal*));
+    ensemble.forceAccelerations = PushArena(&ensemble.workspace, slotCount * sizeof(ForceReal*));
+    for (int slot = 0; slot < slotCount; slot++) {
+        ensemble.scratch[slot] = PushArena(&ensemble.workspace, GetRKScratchSize(BLOCK_DIM) * sizeof(Real));
+        if (forceBuffers) {
+            ensemble.forcePositions[slot] = PushArena(&ensemble.workspace, (BLOCK_DIM / 2) * sizeof(ForceReal));
+            ensemble.forceAccelerations[slot] = PushArena(&ensemble.workspace, (BLOCK_DIM / 2) * sizeof(ForceReal));
+        }
+    }
+
+    // Padding lanes keep zero masses and coincident bodies; softening keeps them finite
+    ensemble.count = count;
+    ensemble.blockCount = blockCount;
+    ensemble.slotCount = slotCount;
+    ensemble.pool = pool;
+    return ensemble;
+}
+
+void UnloadEnsemble(Ensemble ensemble)
+{
+    CoreFree(ensemble.state);
+    CoreFree(ensemble.mass);
+    CoreFree(ensemble.accelerations);
+    UnloadArena(ensemble.workspace);
+}
+
+void SetEnsembleSystem(Ensemble* ensemble, int index, BinarySystem system)
+{
+    Real* block = ensemble->state + (size_t)(index / ENSEMBLE_BLOCK_SIZE) * BLOCK_DIM;
+    ForceReal* mass = ensemble->mass + (size_t)(index / ENSEMBLE_BLOCK_SIZE) * 2 * ENSEMBLE_BLOCK_SIZE;
+    const int lane = index % ENSEMBLE_BLOCK_SIZE;
+
+    const Real values[8] = { system.x1, system.y1, system.x2, system.y2, system.vx1, system.vy1, system.vx2, system.vy2 };
+    for (int component = 0; component < 8; component++) block[component * ENSEMBLE_BLOCK_SIZE + lane] = values[component];
+    mass[lane] = system.m1;
+    mass[ENSEMBLE_BLOCK_SIZE + lane] = system.m2;
+
+    ensemble->accelerationsValid = 0;
+}
+
+BinarySystem GetEnsembleSystem(const Ensemble* ensemble, int index)
+{
+    const Real* block = ensemble->state + (size_t)(index / ENSEMBLE_BLOCK_SIZE) * BLOCK_DIM;
+    const ForceReal* mass = ensemble->mass + (size_t)(index / ENSEMBLE_BLOCK_SIZE) * 2 * ENSEMBLE_BLOCK_SIZE;
+    const int lane = index % ENSEMBLE_BLOCK_SIZE;
+
+    BinarySystem system;
+    system.x1 = block[0 * ENSEMBLE_BLOCK_SIZE + lane];
+    system.y1 = block[1 * ENSEMBLE_BLOCK_SIZE + lane];
+    system.x2 = block[2 * ENSEMBLE_BLOCK_SIZE + lane];
+    system.y2 = block[3 * ENSEMBLE_BLOCK_SIZE + lane];
+    system.vx1 = block[4 * ENSEMBLE_BLOCK_SIZE + lane];
+    system.vy1 = block[5 * ENSEMBLE_BLOCK_SIZE + lane];
+    system.vx2 = block[6 * ENSEMBLE_BLOCK_SIZE + lane];
+    system.vy2 = block[7 * ENSEMBLE_BLOCK_SIZE + lane];
+    system.m1 = mass[lane];
+    system.m2 = mass[ENSEMBLE_BLOCK_SIZE + lane];
+    return system;
+}
+
+BinarySystem MakeBinaryOrbit(ForceReal m1, ForceReal m2, Real separation, Real speedScale)
+{
+    const Real total = (Real)m1 + (Real)m2;
+    const Real speed = speedScale * sqrt(GRAVITY_G * total / separation);
+
+    BinarySystem system = { 0 };
+    system.x1 = -separation * m2 / total;
+    system.x2 = separation * m1 / total;
+    system.vy1 = -speed * m2 / total;
+    system.vy2 = speed * m1 / total;
+    system.m1 = m1;
+    system.m2 = m2;
+    return system;
+}
+
+typedef struct {
+    const ForceReal* mass;
+    ForceReal* forcePositions;
+    ForceReal* forceAccelerations;
+} BlockContext;
+
+static void BlockAcceleration(const Real* positions, Real* accelerations, int halfDim, void* user)
+{
+    const BlockContext* context = user;
+    const int lanes = halfDim / 4;
+
+#if defined(GABRK_PRECISION_MIXED)
+    for (int i = 0; i < halfDim; i++) context->forcePositions[i] = (ForceReal)positions[i];
+    ComputeBinaryAccelerations(context->forcePositions, context->mass, lanes, context->forceAccelerations);
+    for (int i = 0; i < halfDim; i++) accelerations[i] = context->forceAccelerations[i];
+#else
+    ComputeBinaryAccelerations(positions, context->mass, lanes, accelerations);
+#endif
+}
+
+static void BlockDerivative(const Real* state, Real* derivative, int dim, void* user)
+{
+    memcpy(derivative, state + dim / 2, (dim / 2) * sizeof(Real));
+    BlockAcceleration(state, derivative + dim / 2, dim / 2, user);
+}
+
+typedef struct {
+    Ensemble* ensemble;
+    Method method;
+    Real dt;
+} StepJob;
+
+// Called with one index per scratch slot; each slot steps a contiguous run of blocks
+static void StepSlots(int begin, int end, void* user)
+{
+    const StepJob* job = user;
+    Ensemble* ensemble = job->ensemble;
+
+    for (int slot = begin; slot < end; slot++) {
+        const int firstBlock = (int)((long long)ensemble->blockCount * slot / ensemble->slotCount);
+        const int lastBlock = (int)((long long)ensemble->blockCount * (slot + 1) / ensemble->slotCount);
+
+        for (int b = firstBlock; b < lastBlock; b++) {
+            Real* state = ensemble->state + (size_t)b * BLOCK_DIM;
+            BlockContext context = {
+                ensemble->mass + (size_t)b * 2 * ENSEMBLE_BLOCK_SIZE,
+                ensemble->forcePositions[slot],
+                ensemble->forceAccelerations[slot],
+            };
+
+            if (IsSymplecticMethod(job->method)) {
+                int accelerationsValid = ensemble->accelerationsValid;
+                StepSymplectic(job->method, state, state + BLOCK_DIM / 2, BLOCK_DIM / 2, job->dt, BlockAcceleration, &context,
+                               ensemble->accelerations + (size_t)b * BLOCK_DIM / 2, &accelerationsValid);
+            }
+            else {
+                StepRK(job->method, state, BLOCK_DIM, job->dt, BlockDerivative, &context, ensemble->scratch[slot]);
+            }
+        }
+    }
+}
+
+void StepEnsemble(Ensemble* ensemble, Method method, Real dt)
+{
+    StepJob job = { ensemble, method, dt };
+    ParallelFor(ensemble->slotCount > 1 ? ensemble->pool : NULL, ensemble->slotCount, StepSlots, &job);
+    ensemble->accelerationsValid = IsSymplecticMethod(method);
+}
+
+void ComputeEnsembleEnergies(const Ensemble* ensemble, double* energies)
+{
+    const double eps2 = (double)GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+
+    for (int i = 0; i < ensemble->count; i++) {
+        const BinarySystem system = GetEnsembleSystem(ensemble, i);
+        const double dx = (double)system.x2 - system.x1;
+        const double dy = (double)system.y2 - system.y1;
+
+        const double kinetic = 0.5 * system.m1 * ((double)system.vx1 * system.vx1 + (double)system.vy1 * system.vy1) +
+                               0.5 * system.m2 * ((double)system.vx2 * system.vx2 + (double)system.vy2 * system.vy2);
+        const double potential = -(GRAVITY_G * (double)system.m1 * system.m2) / sqrt(dx * dx + dy * dy + eps2);
+        energies[i] = kinetic + potential;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef GABRK_ENSEMBLE_H
+#define GABRK_ENSEMBLE_H
+
+#include "arena.h"
+#include "methods.h"
+#include "precision.h"
+#include "threadpool.h"
+
+#define ENSEMBLE_BLOCK_SIZE 256 // Systems per block; a block's state and stages stay in L2
+
+// One two-body system of an ensemble
+typedef struct {
+    Real x1, y1, x2, y2;
+    Real vx1, vy1, vx2, vy2;
+    ForceReal m1, m2;
+} BinarySystem;
+
+// Many independent two-body systems advanced in lockstep with one method. Systems are
+// stored as lanes in blocks of ENSEMBLE_BLOCK_SIZE: each block's state is the arrays
+// x1, y1, x2, y2, vx1, vy1, vx2, vy2 over its lanes, so the force kernel vectorizes
+// across systems and the usual steppers integrate a block as one flat state. Pool
+// threads step disjoint sets of whole blocks.
+typedef struct {
+    int count;      // Systems; lanes past count in the last block hold massless padding
+    int blockCount;
+    Real* state;    // blockCount * 8 * ENSEMBLE_BLOCK_SIZE
+    ForceReal* mass; // Per block: m1 over the lanes, then m2
+
+    // Symplectic acceleration cache, per block: ax1, ay1, ax2, ay2 over the lanes
+    Real* accelerations;
+    int accelerationsValid;
+
+    // Per-thread RK scratch (and narrowed force buffers in mixed precision), one slot
+    // per thread of the pool the ensemble was loaded with
+    Arena workspace;
+    int slotCount;
+    Real** scratch;
+    ForceReal** forcePositions;
+    ForceReal** forceAccelerations;
+
+    ThreadPool* pool; // Not owned; NULL steps on the calling thread
+} Ensemble;
+
+// The pool is borrowed and its size fixes the number of scratch slots, which caps how
+// many threads later steps use. Returns an ensemble with count 0 on failure.
+Ensemble LoadEnsemble(int count, ThreadPool* pool);
+void UnloadEnsemble(Ensemble ensemble);
+
+void SetEnsembleSystem(Ensemble* ensemble, int index, BinarySystem system);
+BinarySystem GetEnsembleSystem(const Ensemble* ensemble, int index);
+
+// Masses m1 and m2 at the given separation around a center of mass at rest at the
+// origin. speedScale 1 gives a circular orbit; other values give ellipses (or escape).
+BinarySystem MakeBinaryOrbit(ForceReal m1, ForceReal m2, Real separation, Real speedScale);
+
+// Any method works, including the embedded pairs, which then take fixed steps
+void StepEnsemble(Ensemble* ensemble, Method method, Real dt);
+
+// Total (kinetic + potential) energy of every system, accumulated in double
+void ComputeEnsembleEnergies(const Ensemble* ensemble, double* energies);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef GABRK_FILEMAP_H
+#define GABRK_FILEMAP_H
+
+#include <stddef.h>
+
+// Maps a whole file read-only; NULL if it is missing, empty or cannot be mapped. Pages are
+// read on first touch, so only the parts that are used cost I/O.
+const unsigned char* MapFile(const char* path, size_t* size);
+void UnmapFile(const unsigned char* data, size_t size);
+
+#endif
@@ -0,0 +1,193 @@
+#include "gravity.h"
+#include "gravity_kernels.h"
+
+#include <tgmath.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+const char* gravityKernelNames[GRAVITY_KERNEL_COUNT] = {
+    "scalar",
+    "sse",
+    "avx2",
+};
+
+static atomic_int selectedKernel = -1; // Read from worker threads
+
+bool IsGravityKernelSupported(GravityKernel kernel)
+{
+    switch (kernel)
+    {
+        case GRAVITY_KERNEL_SCALAR: return true;
+#if GRAVITY_HAS_X86_KERNELS
+        case GRAVITY_KERNEL_SSE: return __builtin_cpu_supports("sse2");
+        case GRAVITY_KERNEL_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        default: return false;
+    }
+}
+
+GravityKernel GetGravityKernel(void)
+{
+    int kernel = atomic_load_explicit(&selectedKernel, memory_order_relaxed);
+    if (kernel < 0) {
+        kernel = GRAVITY_KERNEL_COUNT - 1;
+        while (kernel > GRAVITY_KERNEL_SCALAR && !IsGravityKernelSupported((GravityKernel)kernel)) kernel--;
+        atomic_store_explicit(&selectedKernel, kernel, memory_order_relaxed);
+    }
+    return (GravityKernel)kernel;
+}
+
+void SetGravityKernel(GravityKernel kernel)
+{
+    if (IsGravityKernelSupported(kernel)) atomic_store_explicit(&selectedKernel, (int)kernel, memory_order_relaxed);
+}
+
+// Instantiated with and without the potential, so the plain force path pays nothing for it
+static inline void AccelerationsScalar(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                                       ForceReal* ax, ForceReal* ay, ForceReal* potential, const int withPotential)
+{
+    const ForceReal eps2 = GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+
+    for (int i = 0; i < count; i++) {
+        ax[i] = 0.0f;
+        ay[i] = 0.0f;
+        if (withPotential) potential[i] = 0.0f;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const ForceReal xi = px[i];
+        const ForceReal yi = py[i];
+        const ForceReal mi = mass[i];
+        ForceReal axi = 0.0f;
+        ForceReal ayi = 0.0f;
+        ForceReal phii = 0.0f;
+
+        for (int j = i + 1; j < count; j++) {
+            const ForceReal dx = px[j] - xi;
+            const ForceReal dy = py[j] - yi;
+            const ForceReal invDistance = 1.0f / sqrt(dx * dx + dy * dy + eps2);
+            const ForceReal scale = GRAVITY_G * invDistance * invDistance * invDistance;
+
+            axi += dx * scale * mass[j];
+            ayi += dy * scale * mass[j];
+            ax[j] -= dx * scale * mi;
+            ay[j] -= dy * scale * mi;
+            if (withPotential) {
+                phii += mass[j] * invDistance;
+                potential[j] -= GRAVITY_G * mi * invDistance;
+            }
+        }
+
+        ax[i] += axi;
+        ay[i] += ayi;
+        if (withPotential) potential[i] -= GRAVITY_G * phii;
+    }
+}
+
+static inline void AccelerationsRangeScalar(const ForceReal* px, const ForceReal* py, const ForceReal* mass,
+                                            int count, int begin, int end, ForceReal* ax, ForceReal* ay,
+                                            ForceReal* potential, const int withPotential)
+{
+    const ForceReal eps2 = GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+    const ForceReal selfInvDistance = 1.0f / sqrt(eps2);
+
+    for (int i = begin; i < end; i++) {
+        const ForceReal xi = px[i];
+        const ForceReal yi = py[i];
+        ForceReal axi = 0.0f;
+        ForceReal ayi = 0.0f;
+        ForceReal phii = 0.0f;
+
+        for (int j = 0; j < count; j++) {
+            const ForceReal dx = px[j] - xi;
+            const ForceReal dy = py[j] - yi;
+            const ForceReal invDistance = 1.0f / sqrt(dx * dx + dy * dy + eps2);
+            const ForceReal scale = GRAVITY_G * mass[j] * invDistance * invDistance * invDistance;
+
+            axi += dx * scale;
+            ayi += dy * scale;
+            if (withPotential) phii += mass[j] * invDistance;
+        }
+
+        ax[i] = axi;
+        ay[i] = ayi;
+        // The self term adds no force but m_i / eps of potential; take it back out
+        if (withPotential) potential[i] = -GRAVITY_G * (phii - mass[i] * selfInvDistance);
+    }
+}
+
+void ComputeAccelerationsScalar(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                                ForceReal* ax, ForceReal* ay, ForceReal* potential)
+{
+    if (potential) AccelerationsScalar(px, py, mass, count, ax, ay, potential, 1);
+    else AccelerationsScalar(px, py, mass, count, ax, ay, NULL, 0);
+}
+
+void ComputeAccelerationsRangeScalar(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                                     int begin, int end, ForceReal* ax, ForceReal* ay, ForceReal* potential)
+{
+    if (potential) AccelerationsRangeScalar(px, py, mass, count, begin, end, ax, ay, potential, 1);
+    else AccelerationsRangeScalar(px, py, mass, count, begin, end, ax, ay, NULL, 0);
+}
+
+void ComputeBinaryAccelerationsScalar(const ForceReal* positions, const ForceReal* mass, int count,
+                                      ForceReal* accelerations)
+{
+    const ForceReal eps2 = GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+    const ForceReal* x1 = positions;
+    const ForceReal* y1 = positions + count;
+    const ForceReal* x2 = positions + 2 * count;
+    const ForceReal* y2 = positions + 3 * count;
+    const ForceReal* m1 = mass;
+    const ForceReal* m2 = mass + count;
+
+    for (int i = 0; i < count; i++) {
+        const ForceReal dx = x2[i] - x1[i];
+        const ForceReal dy = y2[i] - y1[i];
+        const ForceReal invDistance = 1.0f / sqrt(dx * dx + dy * dy + eps2);
+        const ForceReal scale = GRAVITY_G * invDistance * invDistance * invDistance;
+
+        accelerations[i] = dx * scale * m2[i];
+        accelerations[count + i] = dy * scale * m2[i];
+        accelerations[2 * count + i] = -dx * scale * m1[i];
+        accelerations[3 * count + i] = -dy * scale * m1[i];
+    }
+}
+
+void ComputeAccelerations(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                          ForceReal* ax, ForceReal* ay, ForceReal* potential)
+{
+    switch (GetGravityKernel())
+    {
+#if GRAVITY_HAS_X86_KERNELS
+        case GRAVITY_KERNEL_AVX2: ComputeAccelerationsAVX2(px, py, mass, count, ax, ay, potential); break;
+        case GRAVITY_KERNEL_SSE: ComputeAccelerationsSSE(px, py, mass, count, ax, ay, potential); break;
+#endif
+        default: ComputeAccelerationsScalar(px, py, mass, count, ax, ay, potential); break;
+    }
+}
+
+void ComputeAccelerationsRange(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                               int begin, int end, ForceReal* ax, ForceReal* ay, ForceReal* potential)
+{
+    switch (GetGravityKernel())
+    {
+#if GRAVITY_HAS_X86_KERNELS
+        case GRAVITY_KERNEL_AVX2: ComputeAccelerationsRangeAVX2(px, py, mass, count, begin, end, ax, ay, potential); break;
+        case GRAVITY_KERNEL_SSE: ComputeAccelerationsRangeSSE(px, py, mass, count, begin, end, ax, ay, potential); break;
+#endif
+        default: ComputeAccelerationsRangeScalar(px, py, mass, count, begin, end, ax, ay, potential); break;
+    }
+}
+
+void ComputeBinaryAccelerations(const ForceReal* positions, const ForceReal* mass, int count, ForceReal* accelerations)
+{
+    switch (GetGravityKernel())
+    {
+#if GRAVITY_HAS_X86_KERNELS
+        case GRAVITY_KERNEL_AVX2: ComputeBinaryAccelerationsAVX2(positions, mass, count, accelerations); break;
+        case GRAVITY_KERNEL_SSE: ComputeBinaryAccelerationsSSE(positions, mass, count, accelerations); break;
+#endif
+        default: ComputeBinaryAccelerationsScalar(positions, mass, count, accelerations); break;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef GABRK_GRAVITY_H
+#define GABRK_GRAVITY_H
+
+#include "precision.h"
+
+#include <stdbool.h>
+
+#define GRAVITY_G ((ForceReal)1.0)
+#define GRAVITY_SOFTENING ((ForceReal)1.0) // Plummer softening length: F = G m1 m2 r / (r^2 + eps^2)^(3/2)
+
+typedef enum {
+    GRAVITY_KERNEL_SCALAR,
+    GRAVITY_KERNEL_SSE,
+    GRAVITY_KERNEL_AVX2,
+
+    GRAVITY_KERNEL_COUNT
+} GravityKernel;
+
+extern const char* gravityKernelNames[GRAVITY_KERNEL_COUNT];
+
+bool IsGravityKernelSupported(GravityKernel kernel);
+
+// Defaults to the widest kernel the CPU supports. The SIMD kernels work in float, so
+// only the scalar kernel exists in double-precision builds.
+GravityKernel GetGravityKernel(void);
+void SetGravityKernel(GravityKernel kernel);
+
+// All-pairs gravitational accelerations. Each pair is visited once and applied to
+// both bodies (Newton's third law), so the cost is count * (count - 1) / 2 interactions.
+// potential, unless NULL, receives each body's potential -G sum_j m_j / sqrt(r^2 + eps^2)
+// from the same 1/r, so the potential energy sum_i m_i potential_i / 2 costs no extra pass.
+void ComputeAccelerations(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                          ForceReal* ax, ForceReal* ay, ForceReal* potential);
+
+// Gather form for the bodies in [begin, end): each acceleration is a full sum over all
+// count partners (the self term vanishes thanks to softening). Nothing outside the range
+// is written, so disjoint ranges can run concurrently and the result for a body does not
+// depend on how the bodies were split. Costs twice the pair work of ComputeAccelerations.
+void ComputeAccelerationsRange(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                               int begin, int end, ForceReal* ax, ForceReal* ay, ForceReal* potential);
+
+// Accelerations of count independent two-body systems stored as lanes: positions holds
+// the blocks x1, y1, x2, y2, mass holds m1 then m2, and accelerations receives ax1, ay1,
+// ax2, ay2. Lanes never interact, so the kernels vectorize across systems.
+void ComputeBinaryAccelerations(const ForceReal* positions, const ForceReal* mass, int count, ForceReal* accelerations);
+
+#endif
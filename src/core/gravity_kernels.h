@@ -0,0 +1,36 @@
+#ifndef GABRK_GRAVITY_KERNELS_H
+#define GABRK_GRAVITY_KERNELS_H
+
+// Per-ISA implementations behind ComputeAccelerations. Only call the SIMD variants
+// after IsGravityKernelSupported has confirmed the CPU can run them.
+
+#include "precision.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(GABRK_PRECISION_DOUBLE)
+    #define GRAVITY_HAS_X86_KERNELS 1
+#else
+    #define GRAVITY_HAS_X86_KERNELS 0
+#endif
+
+void ComputeAccelerationsScalar(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                                ForceReal* ax, ForceReal* ay, ForceReal* potential);
+void ComputeAccelerationsRangeScalar(const ForceReal* px, const ForceReal* py, const ForceReal* mass, int count,
+                                     int begin, int end, ForceReal* ax, ForceReal* ay, ForceReal* potential);
+void ComputeBinaryAccelerationsScalar(const ForceReal* positions, const ForceReal* mass, int count,
+                                      ForceReal* accelerations);
+
+#if GRAVITY_HAS_X86_KERNELS
+void ComputeAccelerationsSSE(const float* px, const float* py, const float* mass, int count, float* ax, float* ay,
+                             float* potential);
+void ComputeAccelerationsAVX2(const float* px, const float* py, const float* mass, int count, float* ax, float* ay,
+                              float* potential);
+void ComputeAccelerationsRangeSSE(const float* px, const float* py, const float* mass, int count,
+                                  int begin, int end, float* ax, float* ay, float* potential);
+void ComputeAccelerationsRangeAVX2(const float* px, const float* py, const float* mass, int count,
+                                   int begin, int end, float* ax, float* ay, float* potential);
+void ComputeBinaryAccelerationsSSE(const float* positions, const float* mass, int count, float* accelerations);
+void ComputeBinaryAccelerationsAVX2(const float* positions, const float* mass, int count, float* accelerations);
+#endif
+
+#endif
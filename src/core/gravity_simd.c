@@ -0,0 +1,384 @@
+#include "gravity.h"
+#include "gravity_kernels.h"
+
+#if GRAVITY_HAS_X86_KERNELS
+
+#include <immintrin.h>
+#include <math.h>
+
+// Both kernels vectorize the inner j loop of the scalar kernel. The partners j..j+w
+// are contiguous, so the Newton's-third-law update of ax[j]/ay[j] is a plain
+// load-subtract-store and needs no scatter. 1/r comes from the hardware rsqrt
+// estimate (~12 bits) refined by one Newton-Raphson step to ~22 bits. Each kernel is
+// instantiated with and without the potential, which reuses that 1/r.
+
+#define FORCE_INLINE inline __attribute__((always_inline))
+
+static FORCE_INLINE void AccumulatePairScalar(const float* px, const float* py, const float* mass, int i, int j,
+                                              float* axi, float* ayi, float* phii, float* ax, float* ay, float* potential,
+                                              const int withPotential)
+{
+    const float dx = px[j] - px[i];
+    const float dy = py[j] - py[i];
+    const float invDistance = 1.0f / sqrtf(dx * dx + dy * dy + GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const float scale = GRAVITY_G * invDistance * invDistance * invDistance;
+
+    *axi += dx * scale * mass[j];
+    *ayi += dy * scale * mass[j];
+    ax[j] -= dx * scale * mass[i];
+    ay[j] -= dy * scale * mass[i];
+    if (withPotential) {
+        *phii += mass[j] * invDistance;
+        potential[j] -= GRAVITY_G * mass[i] * invDistance;
+    }
+}
+
+static FORCE_INLINE void AccumulateGatherScalar(const float* px, const float* py, const float* mass, int i, int j,
+                                                float* axi, float* ayi, float* phii, const int withPotential)
+{
+    const float dx = px[j] - px[i];
+    const float dy = py[j] - py[i];
+    const float invDistance = 1.0f / sqrtf(dx * dx + dy * dy + GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const float scale = GRAVITY_G * mass[j] * invDistance * invDistance * invDistance;
+
+    *axi += dx * scale;
+    *ayi += dy * scale;
+    if (withPotential) *phii += mass[j] * invDistance;
+}
+
+__attribute__((target("sse2")))
+static inline float HorizontalSum128(__m128 v)
+{
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    sums = _mm_add_ss(sums, shuffled);
+    return _mm_cvtss_f32(sums);
+}
+
+__attribute__((target("avx2,fma")))
+static inline float HorizontalSum256(__m256 v)
+{
+    return HorizontalSum128(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("sse2")))
+static FORCE_INLINE __m128 InverseDistanceSSE(__m128 r2)
+{
+    const __m128 inv = _mm_rsqrt_ps(r2);
+    return _mm_mul_ps(inv, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r2), _mm_mul_ps(inv, inv))));
+}
+
+__attribute__((target("avx2,fma")))
+static FORCE_INLINE __m256 InverseDistanceAVX2(__m256 r2)
+{
+    const __m256 inv = _mm256_rsqrt_ps(r2);
+    return _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), r2), _mm256_mul_ps(inv, inv), _mm256_set1_ps(1.5f)));
+}
+
+__attribute__((target("sse2")))
+static FORCE_INLINE void AccelerationsSSE(const float* px, const float* py, const float* mass, int count, float* ax,
+                                          float* ay, float* potential, const int withPotential)
+{
+    const __m128 eps2 = _mm_set1_ps(GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const __m128 g = _mm_set1_ps(GRAVITY_G);
+
+    for (int i = 0; i < count; i++) {
+        ax[i] = 0.0f;
+        ay[i] = 0.0f;
+        if (withPotential) potential[i] = 0.0f;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const __m128 xi = _mm_set1_ps(px[i]);
+        const __m128 yi = _mm_set1_ps(py[i]);
+        const __m128 mi = _mm_set1_ps(mass[i]);
+        __m128 accX = _mm_setzero_ps();
+        __m128 accY = _mm_setzero_ps();
+        __m128 accP = _mm_setzero_ps();
+
+        int j = i + 1;
+        for (; j + 4 <= count; j += 4) {
+            const __m128 dx = _mm_sub_ps(_mm_loadu_ps(px + j), xi);
+            const __m128 dy = _mm_sub_ps(_mm_loadu_ps(py + j), yi);
+            const __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), eps2);
+
+            const __m128 inv = InverseDistanceSSE(r2);
+            const __m128 scale = _mm_mul_ps(g, _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+
+            const __m128 mj = _mm_loadu_ps(mass + j);
+            const __m128 sj = _mm_mul_ps(scale, mj);
+            accX = _mm_add_ps(accX, _mm_mul_ps(dx, sj));
+            accY = _mm_add_ps(accY, _mm_mul_ps(dy, sj));
+
+            const __m128 si = _mm_mul_ps(scale, mi);
+            _mm_storeu_ps(ax + j, _mm_sub_ps(_mm_loadu_ps(ax + j), _mm_mul_ps(dx, si)));
+            _mm_storeu_ps(ay + j, _mm_sub_ps(_mm_loadu_ps(ay + j), _mm_mul_ps(dy, si)));
+
+            if (withPotential) {
+                accP = _mm_add_ps(accP, _mm_mul_ps(mj, inv));
+                _mm_storeu_ps(potential + j, _mm_sub_ps(_mm_loadu_ps(potential + j), _mm_mul_ps(_mm_mul_ps(g, mi), inv)));
+            }
+        }
+
+        float axi = HorizontalSum128(accX);
+        float ayi = HorizontalSum128(accY);
+        float phii = withPotential ? HorizontalSum128(accP) : 0.0f;
+        for (; j < count; j++) AccumulatePairScalar(px, py, mass, i, j, &axi, &ayi, &phii, ax, ay, potential, withPotential);
+
+        ax[i] += axi;
+        ay[i] += ayi;
+        if (withPotential) potential[i] -= GRAVITY_G * phii;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static FORCE_INLINE void AccelerationsAVX2(const float* px, const float* py, const float* mass, int count, float* ax,
+                                           float* ay, float* potential, const int withPotential)
+{
+    const __m256 eps2 = _mm256_set1_ps(GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const __m256 g = _mm256_set1_ps(GRAVITY_G);
+
+    for (int i = 0; i < count; i++) {
+        ax[i] = 0.0f;
+        ay[i] = 0.0f;
+        if (withPotential) potential[i] = 0.0f;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const __m256 xi = _mm256_set1_ps(px[i]);
+        const __m256 yi = _mm256_set1_ps(py[i]);
+        const __m256 mi = _mm256_set1_ps(mass[i]);
+        __m256 accX = _mm256_setzero_ps();
+        __m256 accY = _mm256_setzero_ps();
+        __m256 accP = _mm256_setzero_ps();
+
+        int j = i + 1;
+        for (; j + 8 <= count; j += 8) {
+            const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(px + j), xi);
+            const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(py + j), yi);
+            const __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, eps2));
+
+            const __m256 inv = InverseDistanceAVX2(r2);
+            const __m256 scale = _mm256_mul_ps(g, _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+
+            const __m256 mj = _mm256_loadu_ps(mass + j);
+            const __m256 sj = _mm256_mul_ps(scale, mj);
+            accX = _mm256_fmadd_ps(dx, sj, accX);
+            accY = _mm256_fmadd_ps(dy, sj, accY);
+
+            const __m256 si = _mm256_mul_ps(scale, mi);
+            _mm256_storeu_ps(ax + j, _mm256_fnmadd_ps(dx, si, _mm256_loadu_ps(ax + j)));
+            _mm256_storeu_ps(ay + j, _mm256_fnmadd_ps(dy, si, _mm256_loadu_ps(ay + j)));
+
+            if (withPotential) {
+                accP = _mm256_fmadd_ps(mj, inv, accP);
+                _mm256_storeu_ps(potential + j, _mm256_fnmadd_ps(_mm256_mul_ps(g, mi), inv, _mm256_loadu_ps(potential + j)));
+            }
+        }
+
+        float axi = HorizontalSum256(accX);
+        float ayi = HorizontalSum256(accY);
+        float phii = withPotential ? HorizontalSum256(accP) : 0.0f;
+        for (; j < count; j++) AccumulatePairScalar(px, py, mass, i, j, &axi, &ayi, &phii, ax, ay, potential, withPotential);
+
+        ax[i] += axi;
+        ay[i] += ayi;
+        if (withPotential) potential[i] -= GRAVITY_G * phii;
+    }
+}
+
+// The gather kernels also meet body i itself. Its acceleration term is zero, but its
+// potential term m_i / eps is not, so it is taken back out with the 1/r of the same
+// path (vector or scalar tail) that added it.
+__attribute__((target("sse2")))
+static FORCE_INLINE void AccelerationsRangeSSE(const float* px, const float* py, const float* mass, int count, int begin,
+                                               int end, float* ax, float* ay, float* potential, const int withPotential)
+{
+    const __m128 eps2 = _mm_set1_ps(GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const __m128 g = _mm_set1_ps(GRAVITY_G);
+    const int vectorEnd = count / 4 * 4;
+    const float selfVector = _mm_cvtss_f32(InverseDistanceSSE(eps2));
+    const float selfScalar = 1.0f / sqrtf(GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+
+    for (int i = begin; i < end; i++) {
+        const __m128 xi = _mm_set1_ps(px[i]);
+        const __m128 yi = _mm_set1_ps(py[i]);
+        __m128 accX = _mm_setzero_ps();
+        __m128 accY = _mm_setzero_ps();
+        __m128 accP = _mm_setzero_ps();
+
+        int j = 0;
+        for (; j + 4 <= count; j += 4) {
+            const __m128 dx = _mm_sub_ps(_mm_loadu_ps(px + j), xi);
+            const __m128 dy = _mm_sub_ps(_mm_loadu_ps(py + j), yi);
+            const __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), eps2);
+
+            const __m128 inv = InverseDistanceSSE(r2);
+            const __m128 mj = _mm_loadu_ps(mass + j);
+            const __m128 sj = _mm_mul_ps(_mm_mul_ps(g, mj), _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+
+            accX = _mm_add_ps(accX, _mm_mul_ps(dx, sj));
+            accY = _mm_add_ps(accY, _mm_mul_ps(dy, sj));
+            if (withPotential) accP = _mm_add_ps(accP, _mm_mul_ps(mj, inv));
+        }
+
+        float axi = HorizontalSum128(accX);
+        float ayi = HorizontalSum128(accY);
+        float phii = withPotential ? HorizontalSum128(accP) : 0.0f;
+        for (; j < count; j++) AccumulateGatherScalar(px, py, mass, i, j, &axi, &ayi, &phii, withPotential);
+
+        ax[i] = axi;
+        ay[i] = ayi;
+        if (withPotential) potential[i] = -GRAVITY_G * (phii - mass[i] * ((i < vectorEnd) ? selfVector : selfScalar));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static FORCE_INLINE void AccelerationsRangeAVX2(const float* px, const float* py, const float* mass, int count, int begin,
+                                                int end, float* ax, float* ay, float* potential, const int withPotential)
+{
+    const __m256 eps2 = _mm256_set1_ps(GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const __m256 g = _mm256_set1_ps(GRAVITY_G);
+    const int vectorEnd = count / 8 * 8;
+    const float selfVector = _mm256_cvtss_f32(InverseDistanceAVX2(eps2));
+    const float selfScalar = 1.0f / sqrtf(GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+
+    for (int i = begin; i < end; i++) {
+        const __m256 xi = _mm256_set1_ps(px[i]);
+        const __m256 yi = _mm256_set1_ps(py[i]);
+        __m256 accX = _mm256_setzero_ps();
+        __m256 accY = _mm256_setzero_ps();
+        __m256 accP = _mm256_setzero_ps();
+
+        int j = 0;
+        for (; j + 8 <= count; j += 8) {
+            const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(px + j), xi);
+            const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(py + j), yi);
+            const __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, eps2));
+
+            const __m256 inv = InverseDistanceAVX2(r2);
+            const __m256 mj = _mm256_loadu_ps(mass + j);
+            const __m256 sj = _mm256_mul_ps(_mm256_mul_ps(g, mj), _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+
+            accX = _mm256_fmadd_ps(dx, sj, accX);
+            accY = _mm256_fmadd_ps(dy, sj, accY);
+            if (withPotential) accP = _mm256_fmadd_ps(mj, inv, accP);
+        }
+
+        float axi = HorizontalSum256(accX);
+        float ayi = HorizontalSum256(accY);
+        float phii = withPotential ? HorizontalSum256(accP) : 0.0f;
+        for (; j < count; j++) AccumulateGatherScalar(px, py, mass, i, j, &axi, &ayi, &phii, withPotential);
+
+        ax[i] = axi;
+        ay[i] = ayi;
+        if (withPotential) potential[i] = -GRAVITY_G * (phii - mass[i] * ((i < vectorEnd) ? selfVector : selfScalar));
+    }
+}
+
+__attribute__((target("sse2")))
+void ComputeAccelerationsSSE(const float* px, const float* py, const float* mass, int count, float* ax, float* ay,
+                             float* potential)
+{
+    if (potential) AccelerationsSSE(px, py, mass, count, ax, ay, potential, 1);
+    else AccelerationsSSE(px, py, mass, count, ax, ay, NULL, 0);
+}
+
+__attribute__((target("avx2,fma")))
+void ComputeAccelerationsAVX2(const float* px, const float* py, const float* mass, int count, float* ax, float* ay,
+                              float* potential)
+{
+    if (potential) AccelerationsAVX2(px, py, mass, count, ax, ay, potential, 1);
+    else AccelerationsAVX2(px, py, mass, count, ax, ay, NULL, 0);
+}
+
+__attribute__((target("sse2")))
+void ComputeAccelerationsRangeSSE(const float* px, const float* py, const float* mass, int count,
+                                  int begin, int end, float* ax, float* ay, float* potential)
+{
+    if (potential) AccelerationsRangeSSE(px, py, mass, count, begin, end, ax, ay, potential, 1);
+    else AccelerationsRangeSSE(px, py, mass, count, begin, end, ax, ay, NULL, 0);
+}
+
+__attribute__((target("avx2,fma")))
+void ComputeAccelerationsRangeAVX2(const float* px, const float* py, const float* mass, int count,
+                                   int begin, int end, float* ax, float* ay, float* potential)
+{
+    if (potential) AccelerationsRangeAVX2(px, py, mass, count, begin, end, ax, ay, potential, 1);
+    else AccelerationsRangeAVX2(px, py, mass, count, begin, end, ax, ay, NULL, 0);
+}
+
+// The binary kernels need no reduction: each lane is a whole system
+static inline void BinaryLaneScalar(const float* positions, const float* mass, int count, int i, float* accelerations)
+{
+    const float dx = positions[2 * count + i] - positions[i];
+    const float dy = positions[3 * count + i] - positions[count + i];
+    const float invDistance = 1.0f / sqrtf(dx * dx + dy * dy + GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const float scale = GRAVITY_G * invDistance * invDistance * invDistance;
+
+    accelerations[i] = dx * scale * mass[count + i];
+    accelerations[count + i] = dy * scale * mass[count + i];
+    accelerations[2 * count + i] = -dx * scale * mass[i];
+    accelerations[3 * count + i] = -dy * scale * mass[i];
+}
+
+__attribute__((target("sse2")))
+void ComputeBinaryAccelerationsSSE(const float* positions, const float* mass, int count, float* accelerations)
+{
+    const __m128 eps2 = _mm_set1_ps(GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 g = _mm_set1_ps(GRAVITY_G);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(positions + 2 * count + i), _mm_loadu_ps(positions + i));
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(positions + 3 * count + i), _mm_loadu_ps(positions + count + i));
+        const __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), eps2);
+
+        __m128 inv = _mm_rsqrt_ps(r2);
+        inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv, inv))));
+        const __m128 scale = _mm_mul_ps(g, _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+
+        const __m128 s1 = _mm_mul_ps(scale, _mm_loadu_ps(mass + count + i));
+        const __m128 s2 = _mm_mul_ps(scale, _mm_loadu_ps(mass + i));
+        _mm_storeu_ps(accelerations + i, _mm_mul_ps(dx, s1));
+        _mm_storeu_ps(accelerations + count + i, _mm_mul_ps(dy, s1));
+        _mm_storeu_ps(accelerations + 2 * count + i, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(dx, s2)));
+        _mm_storeu_ps(accelerations + 3 * count + i, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(dy, s2)));
+    }
+
+    for (; i < count; i++) BinaryLaneScalar(positions, mass, count, i, accelerations);
+}
+
+__attribute__((target("avx2,fma")))
+void ComputeBinaryAccelerationsAVX2(const float* positions, const float* mass, int count, float* accelerations)
+{
+    const __m256 eps2 = _mm256_set1_ps(GRAVITY_SOFTENING * GRAVITY_SOFTENING);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 g = _mm256_set1_ps(GRAVITY_G);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(positions + 2 * count + i), _mm256_loadu_ps(positions + i));
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(positions + 3 * count + i), _mm256_loadu_ps(positions + count + i));
+        const __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, eps2));
+
+        __m256 inv = _mm256_rsqrt_ps(r2);
+        inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv, inv), threeHalves));
+        const __m256 scale = _mm256_mul_ps(g, _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+
+        const __m256 s1 = _mm256_mul_ps(scale, _mm256_loadu_ps(mass + count + i));
+        const __m256 s2 = _mm256_mul_ps(scale, _mm256_loadu_ps(mass + i));
+        _mm256_storeu_ps(accelerations + i, _mm256_mul_ps(dx, s1));
+        _mm256_storeu_ps(accelerations + count + i, _mm256_mul_ps(dy, s1));
+        _mm256_storeu_ps(accelerations + 2 * count + i, _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(dx, s2)));
+        _mm256_storeu_ps(accelerations + 3 * count + i, _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(dy, s2)));
+    }
+
+    for (; i < count; i++) BinaryLaneScalar(positions, mass, count, i, accelerations);
+}
+
+#endif
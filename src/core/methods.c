@@ -0,0 +1,41 @@
+#include "methods.h"
+#include "rk.h"
+#include "symplectic.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+const char* GetMethodName(Method method)
+{
+    return IsSymplecticMethod(method) ? symplecticSchemes[method - RK_METHOD_COUNT].name : rkTableaus[method].name;
+}
+
+static int NamesMatch(const char* a, const char* b)
+{
+    for (;;) {
+        while (*a && !isalnum((unsigned char)*a)) a++;
+        while (*b && !isalnum((unsigned char)*b)) b++;
+        if (!*a || !*b) return !*a && !*b;
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return 0;
+        a++;
+        b++;
+    }
+}
+
+int FindMethod(const char* name)
+{
+    for (int method = 0; method < METHOD_COUNT; method++) {
+        if (NamesMatch(name, GetMethodName((Method)method))) return method;
+    }
+
+    char* end = NULL;
+    const long index = strtol(name, &end, 10);
+    if (end != name && *end == '\0' && index >= 0 && index < METHOD_COUNT) return (int)index;
+
+    return -1;
+}
+
+int IsEmbeddedMethod(Method method)
+{
+    return !IsSymplecticMethod(method) && rkTableaus[method].embeddedOrder > 0;
+}
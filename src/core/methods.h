@@ -0,0 +1,25 @@
+#ifndef GABRK_METHODS_H
+#define GABRK_METHODS_H
+
+// Every integrator the simulation can run. Runge-Kutta methods come first and index
+// rkTableaus; the symplectic compositions after them index symplecticSchemes.
+typedef enum {
+#include "rk_methods.inc" // One entry per method in rk_tableaus.def, generated by tools/rkgen.c
+    Velocity_Verlet, Yoshida4, Yoshida6,
+
+    METHOD_COUNT
+} Method;
+
+#define RK_METHOD_COUNT Velocity_Verlet
+#define SYMPLECTIC_METHOD_COUNT (METHOD_COUNT - RK_METHOD_COUNT)
+
+const char* GetMethodName(Method method);
+
+// Matches a method name ignoring case and punctuation ("rk4-3/8", "RK4 3/8") or a method
+// index. Returns -1 if nothing matches.
+int FindMethod(const char* name);
+
+static inline int IsSymplecticMethod(Method method) { return method >= RK_METHOD_COUNT; }
+int IsEmbeddedMethod(Method method);
+
+#endif
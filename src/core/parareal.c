@@ -0,0 +1,168 @@
+#include "parareal.h"
+#include "allocator.h"
+
+#include <string.h>
+#include <tgmath.h>
+
+PararealSolver LoadPararealSolver(int count, int sliceCount, ThreadPool* pool)
+{
+    PararealSolver solver = { 0 };
+    if (sliceCount <= 0) sliceCount = GetThreadPoolSize(pool);
+    if (count <= 0 || sliceCount <= 0) return solver;
+
+    const int dim = 4 * count;
+    solver.sliceCount = sliceCount;
+    solver.dim = dim;
+    solver.pool = pool;
+    solver.boundaries = CoreAlloc((size_t)(sliceCount + 1) * dim * sizeof(Real));
+    solver.coarse = CoreAlloc((size_t)sliceCount * dim * sizeof(Real));
+    solver.slices = CoreCalloc(sliceCount, sizeof(BodySystem));
+    solver.coarseSystem = LoadBodySystem(count);
+    if (!solver.boundaries || !solver.coarse || !solver.slices || solver.coarseSystem.count == 0) {
+        UnloadPararealSolver(solver);
+        return (PararealSolver){ 0 };
+    }
+
+    for (int n = 0; n < sliceCount; n++) {
+        solver.slices[n] = LoadBodySystem(count);
+        if (solver.slices[n].count == 0) {
+            UnloadPararealSolver(solver);
+            return (PararealSolver){ 0 };
+        }
+    }
+    return solver;
+}
+
+void UnloadPararealSolver(PararealSolver solver)
+{
+    if (solver.slices) {
+        for (int n = 0; n < solver.sliceCount; n++) UnloadBodySystem(solver.slices[n]);
+    }
+    CoreFree(solver.slices);
+    CoreFree(solver.boundaries);
+    CoreFree(solver.coarse);
+    UnloadBodySystem(solver.coarseSystem);
+}
+
+// First fine step of slice n; slices differ by at most one step
+static long GetSliceStart(long steps, int sliceCount, int n)
+{
+    return (long)((long long)steps * n / sliceCount);
+}
+
+static void CopyBodySettings(BodySystem* target, const BodySystem* source)
+{
+    memcpy(target->mass, source->mass, source->count * sizeof(ForceReal));
+    target->forceSolver = source->forceSolver;
+    target->theta = source->theta;
+    target->cutoff = source->cutoff;
+    target->forceEvaluations = 0;
+}
+
+// Runs the propagator over slice n from start; the result is left in propagator->state
+static void PropagateSlice(BodySystem* propagator, const Real* start, int dim, Method method, long stepCount, Real dt)
+{
+    memcpy(propagator->state, start, dim * sizeof(Real));
+    propagator->accelerationsValid = 0;
+    for (long s = 0; s < stepCount; s++) StepBodySystem(propagator, method, dt);
+}
+
+typedef struct {
+    PararealSolver* solver;
+    const PararealSettings* settings;
+    long steps;
+    int first;
+} FineJob;
+
+static void FineRange(int begin, int end, void* user)
+{
+    const FineJob* job = user;
+    PararealSolver* solver = job->solver;
+
+    for (int n = job->first + begin; n < job->first + end; n++) {
+        const long stepCount = GetSliceStart(job->steps, solver->sliceCount, n + 1) - GetSliceStart(job->steps, solver->sliceCount, n);
+        PropagateSlice(&solver->slices[n], solver->boundaries + (size_t)n * solver->dim, solver->dim,
+                       job->settings->fineMethod, stepCount, job->settings->fineDt);
+    }
+}
+
+// G over slice n, covering the same time as its fine steps; the result is in coarseSystem.state
+static void CoarseSlice(PararealSolver* solver, long steps, const PararealSettings* settings, int n)
+{
+    const long fineSteps = GetSliceStart(steps, solver->sliceCount, n + 1) - GetSliceStart(steps, solver->sliceCount, n);
+    const long coarseSteps = (fineSteps > 0) ? settings->coarseSteps : 0;
+    const Real dt = (coarseSteps > 0) ? settings->fineDt * (Real)fineSteps / (Real)coarseSteps : 0;
+
+    PropagateSlice(&solver->coarseSystem, solver->boundaries + (size_t)n * solver->dim, solver->dim,
+                   settings->coarseMethod, coarseSteps, dt);
+}
+
+PararealResult IntegrateParareal(PararealSolver* solver, BodySystem* system, long steps, const PararealSettings* settings)
+{
+    PararealResult result = { 0 };
+    const int dim = solver->dim;
+    const int sliceCount = solver->sliceCount;
+    const int maxIterations = (settings->maxIterations > 0 && settings->maxIterations < sliceCount) ? settings->maxIterations : sliceCount;
+    Real* coarseState = solver->coarseSystem.state;
+
+    CopyBodySettings(&solver->coarseSystem, system);
+    for (int n = 0; n < sliceCount; n++) CopyBodySettings(&solver->slices[n], system);
+
+    // Iteration zero: the boundaries are the serial coarse sweep
+    memcpy(solver->boundaries, system->state, dim * sizeof(Real));
+    for (int n = 0; n < sliceCount; n++) {
+        CoarseSlice(solver, steps, settings, n);
+        memcpy(solver->coarse + (size_t)n * dim, coarseState, dim * sizeof(Real));
+        memcpy(solver->boundaries + (size_t)(n + 1) * dim, coarseState, dim * sizeof(Real));
+    }
+
+    // Boundaries up to first are exact: each iteration extends them by at least one slice
+    for (int first = 0; first < sliceCount && result.iterations < maxIterations; first++) {
+        FineJob job = { solver, settings, steps, first };
+        ParallelFor(solver->pool, sliceCount - first, FineRange, &job);
+        result.iterations++;
+
+        long long longest = 0;
+        for (int n = first; n < sliceCount; n++) {
+            longest = (solver->slices[n].forceEvaluations > longest) ? solver->slices[n].forceEvaluations : longest;
+            system->forceEvaluations += solver->slices[n].forceEvaluations;
+            solver->slices[n].forceEvaluations = 0;
+        }
+        result.criticalEvaluations += longest;
+
+        // The slice after the exact boundary takes the fine result as is, so a run through
+        // every slice reproduces the serial fine integration exactly
+        double change = 0.0;
+        double scale = 0.0;
+        Real* next = solver->boundaries + (size_t)(first + 1) * dim;
+        for (int i = 0; i < dim; i++) {
+            change = fmax(change, fabs((double)solver->slices[first].state[i] - (double)next[i]));
+            next[i] = solver->slices[first].state[i];
+        }
+
+        for (int n = first + 1; n < sliceCount; n++) {
+            CoarseSlice(solver, steps, settings, n);
+
+            const Real* fine = solver->slices[n].state;
+            Real* coarse = solver->coarse + (size_t)n * dim;
+            next = solver->boundaries + (size_t)(n + 1) * dim;
+            for (int i = 0; i < dim; i++) {
+                const Real corrected = coarseState[i] + (fine[i] - coarse[i]);
+                change = fmax(change, fabs((double)corrected - (double)next[i]));
+                next[i] = corrected;
+                coarse[i] = coarseState[i];
+            }
+        }
+
+        for (int i = 0; i < dim; i++) scale = fmax(scale, fabs((double)solver->boundaries[(size_t)sliceCount * dim + i]));
+        result.change = (scale > 0.0) ? change / scale : change;
+        result.converged = (first + 1 == sliceCount) || result.change <= settings->tolerance;
+        if (result.converged) break;
+    }
+
+    memcpy(system->state, solver->boundaries + (size_t)sliceCount * dim, dim * sizeof(Real));
+    system->accelerationsValid = 0;
+    system->forceEvaluations += solver->coarseSystem.forceEvaluations;
+    result.criticalEvaluations += solver->coarseSystem.forceEvaluations;
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef GABRK_PARAREAL_H
+#define GABRK_PARAREAL_H
+
+#include "bodies.h"
+#include "methods.h"
+#include "precision.h"
+#include "threadpool.h"
+
+// Parallel-in-time integration (Lions, Maday and Turinici 2001). The horizon is cut into
+// slices; a cheap coarse propagator G sweeps them serially, an accurate fine propagator
+// F runs every slice concurrently from the current guesses of their starting states,
+// and each iteration corrects the boundaries with U[n+1] = G(U[n]) + F(U[n]) - G_old(U[n]).
+// Small systems with long horizons, which have no spatial parallelism, can use every core.
+typedef struct {
+    Method fineMethod;
+    Real fineDt;
+    Method coarseMethod;
+    int coarseSteps;    // Coarse steps per slice
+    int maxIterations;  // 0 iterates until converged, at most once per slice
+    Real tolerance;     // Converged once no boundary moves by more than this times the largest state component
+} PararealSettings;
+
+typedef struct {
+    int iterations;
+    double change;      // Largest boundary change of the last iteration, relative as for tolerance
+    int converged;
+
+    // Force evaluations on the critical path: every coarse sweep plus the longest slice of
+    // each fine pass. Total work over this is the speedup with one core per slice.
+    long long criticalEvaluations;
+} PararealResult;
+
+typedef struct {
+    int sliceCount;
+    int dim;
+    Real* boundaries;   // sliceCount + 1 states: the start of every slice and the end state
+    Real* coarse;       // G of every slice from the previous iteration
+    BodySystem* slices; // One fine propagator per slice, so slices run concurrently
+    BodySystem coarseSystem;
+    ThreadPool* pool;   // Not owned; NULL runs the slices on the calling thread
+} PararealSolver;
+
+// Sized for systems of count bodies. sliceCount 0 uses one slice per pool thread. Returns
+// a solver with sliceCount 0 on failure.
+PararealSolver LoadPararealSolver(int count, int sliceCount, ThreadPool* pool);
+void UnloadPararealSolver(PararealSolver solver);
+
+// Advances system by steps fine steps of settings->fineDt. Masses and force settings come
+// from system; its own pool is not used. Once the iterations reach the last slice every
+// boundary is exact, and the result is bit for bit that of stepping system serially
+// without a pool.
+PararealResult IntegrateParareal(PararealSolver* solver, BodySystem* system, long steps, const PararealSettings* settings);
+
+#endif
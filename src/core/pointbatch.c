@@ -0,0 +1,135 @@
+#include "pointbatch.h"
+#include "allocator.h"
+
+#include <math.h>
+#include <string.h>
+
+#define MIN_POINT_RADIUS 0.75f // Smaller discs would miss every pixel center; the shader clamps the same way
+
+PointBatch LoadPointBatch(int capacity)
+{
+    PointBatch batch = { 0 };
+    batch.instances = CoreAlloc((size_t)capacity * sizeof(PointInstance));
+    if (batch.instances) batch.capacity = capacity;
+    return batch;
+}
+
+void UnloadPointBatch(PointBatch batch)
+{
+    CoreFree(batch.instances);
+}
+
+static inline PointColor GetPaletteColor(const PointColor* palette, int paletteCount, int index)
+{
+    return palette[(index < paletteCount) ? index : paletteCount - 1];
+}
+
+void AddBodyPoints(PointBatch* batch, const float* x, const float* y, int count, float radius,
+                   const PointColor* palette, int paletteCount)
+{
+    if (count > batch->capacity - batch->count) count = batch->capacity - batch->count;
+
+    PointInstance* out = batch->instances + batch->count;
+    for (int i = 0; i < count; i++) out[i] = (PointInstance){ x[i], y[i], radius, GetPaletteColor(palette, paletteCount, i) };
+    batch->count += count;
+}
+
+TrailBuffer LoadTrailBuffer(int frames, int count)
+{
+    TrailBuffer trail = { 0 };
+    trail.x = CoreAlloc((size_t)frames * count * sizeof(float));
+    trail.y = CoreAlloc((size_t)frames * count * sizeof(float));
+    if (!trail.x || !trail.y) {
+        UnloadTrailBuffer(trail);
+        return (TrailBuffer){ 0 };
+    }
+
+    trail.frames = frames;
+    trail.count = count;
+    return trail;
+}
+
+void UnloadTrailBuffer(TrailBuffer trail)
+{
+    CoreFree(trail.x);
+    CoreFree(trail.y);
+}
+
+void PushTrailFrame(TrailBuffer* trail, const float* x, const float* y)
+{
+    if (trail->frames == 0) return;
+
+    memcpy(trail->x + (size_t)trail->head * trail->count, x, trail->count * sizeof(float));
+    memcpy(trail->y + (size_t)trail->head * trail->count, y, trail->count * sizeof(float));
+    trail->head = (trail->head + 1) % trail->frames;
+    if (trail->length < trail->frames) trail->length++;
+}
+
+void AddTrailPoints(PointBatch* batch, const TrailBuffer* trail, float radius, const PointColor* palette,
+                    int paletteCount, unsigned char alpha)
+{
+    if (trail->length == 0) return;
+    const int oldest = (trail->head - trail->length + trail->frames) % trail->frames;
+
+    for (int age = 0; age < trail->length; age++) {
+        const int slot = (oldest + age) % trail->frames;
+        const float* x = trail->x + (size_t)slot * trail->count;
+        const float* y = trail->y + (size_t)slot * trail->count;
+        const unsigned char fade = (unsigned char)(alpha * (age + 1) / (trail->length + 1));
+
+        int count = trail->count;
+        if (count > batch->capacity - batch->count) count = batch->capacity - batch->count;
+
+        PointInstance* out = batch->instances + batch->count;
+        for (int i = 0; i < count; i++) {
+            PointColor color = GetPaletteColor(palette, paletteCount, i);
+            color.a = (unsigned char)(color.a * fade / 255);
+            out[i] = (PointInstance){ x[i], y[i], radius, color };
+        }
+        batch->count += count;
+    }
+}
+
+void FillPointCanvas(unsigned char* pixels, int width, int height, PointColor color)
+{
+    PointColor* out = (PointColor*)pixels;
+    for (size_t i = 0; i < (size_t)width * height; i++) out[i] = color;
+}
+
+// Source-over blend of color into an opaque destination pixel
+static inline void BlendPixel(PointColor* pixel, PointColor color)
+{
+    const int a = color.a;
+    pixel->r = (unsigned char)((color.r * a + pixel->r * (255 - a) + 127) / 255);
+    pixel->g = (unsigned char)((color.g * a + pixel->g * (255 - a) + 127) / 255);
+    pixel->b = (unsigned char)((color.b * a + pixel->b * (255 - a) + 127) / 255);
+}
+
+void RasterizePointBatch(const PointBatch* batch, unsigned char* pixels, int width, int height)
+{
+    PointColor* canvas = (PointColor*)pixels;
+
+    for (int n = 0; n < batch->count; n++) {
+        const PointInstance* point = &batch->instances[n];
+        if (point->color.a == 0) continue;
+
+        // Pixels whose centers fall inside the disc, clipped to the canvas. The negated test
+        // also skips NaN positions.
+        const float radius = fmaxf(point->radius, MIN_POINT_RADIUS);
+        if (!(point->x + radius >= 0.0f && point->x - radius <= width && point->y + radius >= 0.0f &&
+              point->y - radius <= height)) continue;
+        const int minX = (int)fmaxf(ceilf(point->x - radius - 0.5f), 0.0f);
+        const int maxX = (int)fminf(floorf(point->x + radius - 0.5f), width - 1.0f);
+        const int minY = (int)fmaxf(ceilf(point->y - radius - 0.5f), 0.0f);
+        const int maxY = (int)fminf(floorf(point->y + radius - 0.5f), height - 1.0f);
+
+        for (int py = minY; py <= maxY; py++) {
+            const float dy = py + 0.5f - point->y;
+            PointColor* row = canvas + (size_t)py * width;
+            for (int px = minX; px <= maxX; px++) {
+                const float dx = px + 0.5f - point->x;
+                if (dx * dx + dy * dy <= radius * radius) BlendPixel(&row[px], point->color);
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef GABRK_POINTBATCH_H
+#define GABRK_POINTBATCH_H
+
+typedef struct {
+    unsigned char r, g, b, a;
+} PointColor;
+
+// One disc, laid out as the GPU instance attributes: position and radius, then color
+typedef struct {
+    float x;
+    float y;
+    float radius;
+    PointColor color;
+} PointInstance;
+
+// Every disc drawn in a frame, built on the CPU and handed to the renderer in one piece:
+// the GPU path uploads it as a single instance buffer, the software path rasterizes it
+typedef struct {
+    int capacity;
+    int count;
+    PointInstance* instances;
+} PointBatch;
+
+PointBatch LoadPointBatch(int capacity);
+void UnloadPointBatch(PointBatch batch);
+
+static inline void ClearPointBatch(PointBatch* batch) { batch->count = 0; }
+
+// Adds count bodies from an x block and a y block. Body i takes palette[i], or the last
+// palette entry past its end. Bodies past the capacity are dropped.
+void AddBodyPoints(PointBatch* batch, const float* x, const float* y, int count, float radius,
+                   const PointColor* palette, int paletteCount);
+
+// Past positions of every body, one frame per push, overwriting the oldest when full
+typedef struct {
+    int frames; // Capacity in frames
+    int count;  // Bodies per frame
+    int head;   // Slot the next push writes
+    int length; // Frames held
+    float* x;   // frames blocks of count values
+    float* y;
+} TrailBuffer;
+
+TrailBuffer LoadTrailBuffer(int frames, int count);
+void UnloadTrailBuffer(TrailBuffer trail);
+
+static inline void ClearTrailBuffer(TrailBuffer* trail) { trail->head = 0; trail->length = 0; }
+
+void PushTrailFrame(TrailBuffer* trail, const float* x, const float* y);
+
+// Adds the held frames oldest first, so newer points draw over older ones, fading from
+// transparent up to alpha
+void AddTrailPoints(PointBatch* batch, const TrailBuffer* trail, float radius, const PointColor* palette,
+                    int paletteCount, unsigned char alpha);
+
+// Software renderer for machines without instancing (or without a GPU at all): RGBA8
+// pixels, row by row, with the same disc coverage as the GPU shader
+void FillPointCanvas(unsigned char* pixels, int width, int height, PointColor color);
+void RasterizePointBatch(const PointBatch* batch, unsigned char* pixels, int width, int height);
+
+#endif
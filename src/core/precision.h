@@ -0,0 +1,25 @@
+#ifndef GABRK_PRECISION_H
+#define GABRK_PRECISION_H
+
+// Floating-point types, selected at configure time with GABRK_PRECISION:
+//   float  - state, integrators and force kernels in float (default)
+//   double - all of them in double; the SIMD force kernels are float-only and drop out
+//   mixed  - double state and integrator arithmetic around the float force kernels
+// Real is the state and integrator type, ForceReal the type of positions, masses and
+// accelerations inside the force kernels.
+
+#if defined(GABRK_PRECISION_DOUBLE)
+    typedef double Real;
+    typedef double ForceReal;
+    #define GABRK_PRECISION_NAME "double"
+#elif defined(GABRK_PRECISION_MIXED)
+    typedef double Real;
+    typedef float ForceReal;
+    #define GABRK_PRECISION_NAME "mixed"
+#else
+    typedef float Real;
+    typedef float ForceReal;
+    #define GABRK_PRECISION_NAME "float"
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+#include "profiler.h"
+#include "allocator.h"
+#include "clock.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+const char* profileZoneNames[PROFILE_ZONE_COUNT] = {
+    "step",
+    "forces",
+    "tree build",
+    "sort",
+    "stages",
+    "diagnostics",
+    "snapshot",
+    "render",
+};
+
+typedef struct {
+    atomic_llong calls;
+    atomic_llong nanoseconds;
+} ZoneCounters;
+
+typedef struct {
+    atomic_llong steps;
+    atomic_llong bodySteps;
+    atomic_llong forceEvaluations;
+    atomic_llong nanoseconds;
+} MethodCounters;
+
+typedef struct {
+    long long start;
+    long long duration;
+    short zone;
+    short method; // -1 outside steps
+    int thread;
+} ProfileEvent;
+
+// Zones are recorded from the simulation, pool and render threads at once, so everything
+// is atomic; relaxed adds are enough for totals that are only ever read as statistics
+static ZoneCounters zoneCounters[PROFILE_ZONE_COUNT];
+static MethodCounters methodCounters[METHOD_COUNT];
+
+static ProfileEvent* traceEvents;
+static int traceCapacity;
+static atomic_bool tracing;
+static atomic_llong traceReserved;  // Slots handed out, may exceed the capacity
+static atomic_llong traceCommitted; // Slots within the capacity fully written
+static atomic_int nextThreadId;
+static _Thread_local int threadId; // 0 until the thread records its first event
+
+bool IsProfilingEnabled(void)
+{
+#if defined(GABRK_PROFILE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+long long GetProfileTime(void)
+{
+    return GetClockNanoseconds();
+}
+
+static void RecordEvent(ProfileZone zone, int method, long long start, long long duration)
+{
+    if (!atomic_load_explicit(&tracing, memory_order_acquire)) return;
+
+    const long long slot = atomic_fetch_add_explicit(&traceReserved, 1, memory_order_relaxed);
+    if (slot >= traceCapacity) return;
+
+    if (threadId == 0) threadId = atomic_fetch_add_explicit(&nextThreadId, 1, memory_order_relaxed) + 1;
+    traceEvents[slot] = (ProfileEvent){ start, duration, (short)zone, (short)method, threadId };
+    atomic_fetch_add_explicit(&traceCommitted, 1, memory_order_release);
+}
+
+void EndProfileZone(ProfileZone zone, long long start)
+{
+    const long long duration = GetProfileTime() - start;
+    atomic_fetch_add_explicit(&zoneCounters[zone].calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&zoneCounters[zone].nanoseconds, duration, memory_order_relaxed);
+    RecordEvent(zone, -1, start, duration);
+}
+
+void EndProfileStep(Method method, int bodies, long long forceEvaluations, long long start)
+{
+    const long long duration = GetProfileTime() - start;
+    MethodCounters* counters = &methodCounters[method];
+    atomic_fetch_add_explicit(&counters->steps, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->bodySteps, bodies, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->forceEvaluations, forceEvaluations, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->nanoseconds, duration, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&zoneCounters[PROFILE_STEP].calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&zoneCounters[PROFILE_STEP].nanoseconds, duration, memory_order_relaxed);
+    RecordEvent(PROFILE_STEP, method, start, duration);
+}
+
+void GetProfileSnapshot(ProfileSnapshot* snapshot)
+{
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        snapshot->zones[zone].calls = atomic_load_explicit(&zoneCounters[zone].calls, memory_order_relaxed);
+        snapshot->zones[zone].nanoseconds = atomic_load_explicit(&zoneCounters[zone].nanoseconds, memory_order_relaxed);
+    }
+    for (int method = 0; method < METHOD_COUNT; method++) {
+        const MethodCounters* counters = &methodCounters[method];
+        ProfileMethodStats* stats = &snapshot->methods[method];
+        stats->steps = atomic_load_explicit(&counters->steps, memory_order_relaxed);
+        stats->bodySteps = atomic_load_explicit(&counters->bodySteps, memory_order_relaxed);
+        stats->forceEvaluations = atomic_load_explicit(&counters->forceEvaluations, memory_order_relaxed);
+        stats->nanoseconds = atomic_load_explicit(&counters->nanoseconds, memory_order_relaxed);
+    }
+}
+
+void ResetProfile(void)
+{
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        atomic_store_explicit(&zoneCounters[zone].calls, 0, memory_order_relaxed);
+        atomic_store_explicit(&zoneCounters[zone].nanoseconds, 0, memory_order_relaxed);
+    }
+    for (int method = 0; method < METHOD_COUNT; method++) {
+        atomic_store_explicit(&methodCounters[method].steps, 0, memory_order_relaxed);
+        atomic_store_explicit(&methodCounters[method].bodySteps, 0, memory_order_relaxed);
+        atomic_store_explicit(&methodCounters[method].forceEvaluations, 0, memory_order_relaxed);
+        atomic_store_explicit(&methodCounters[method].nanoseconds, 0, memory_order_relaxed);
+    }
+}
+
+bool StartProfileTrace(int capacity)
+{
+    if (atomic_load_explicit(&tracing, memory_order_relaxed)) return true;
+
+    // The buffer is kept between traces: a thread that saw tracing just before it stopped
+    // may still be writing its last event
+    if (!traceEvents) {
+        traceEvents = CoreAlloc((size_t)capacity * sizeof(ProfileEvent));
+        if (!traceEvents) return false;
+        traceCapacity = capacity;
+    }
+
+    atomic_store_explicit(&traceReserved, 0, memory_order_relaxed);
+    atomic_store_explicit(&traceCommitted, 0, memory_order_relaxed);
+    atomic_store_explicit(&tracing, true, memory_order_release);
+    return true;
+}
+
+bool IsProfileTracing(void)
+{
+    return atomic_load_explicit(&tracing, memory_order_relaxed);
+}
+
+bool WriteProfileTrace(const char* path, long long* dropped)
+{
+    atomic_store_explicit(&tracing, false, memory_order_seq_cst);
+
+    // Wait for events that were already reserved to be written
+    const long long reserved = atomic_load_explicit(&traceReserved, memory_order_seq_cst);
+    const long long count = (reserved < traceCapacity) ? reserved : traceCapacity;
+    while (atomic_load_explicit(&traceCommitted, memory_order_acquire) < count) { }
+    if (dropped) *dropped = reserved - count;
+
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+
+    // Complete ("X") events with microsecond times relative to the first one
+    long long origin = 0;
+    for (long long i = 0; i < count; i++) {
+        if (i == 0 || traceEvents[i].start < origin) origin = traceEvents[i].start;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (long long i = 0; i < count; i++) {
+        const ProfileEvent* event = &traceEvents[i];
+        fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"gabrk\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                i ? ",\n" : "", profileZoneNames[event->zone], event->thread, (event->start - origin) * 1e-3,
+                event->duration * 1e-3);
+        if (event->method >= 0) fprintf(file, ",\"args\":{\"method\":\"%s\"}", GetMethodName(event->method));
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+void UnloadProfileTrace(void)
+{
+    atomic_store_explicit(&tracing, false, memory_order_seq_cst);
+    CoreFree(traceEvents);
+    traceEvents = NULL;
+    traceCapacity = 0;
+}
@@ -0,0 +1,79 @@
+#ifndef GABRK_PROFILER_H
+#define GABRK_PROFILER_H
+
+#include <stdbool.h>
+
+#include "methods.h"
+
+// Hot-path timers and counters. The PROFILE_ macros expand to nothing unless the core is
+// built with GABRK_PROFILE (cmake -DGABRK_PROFILE=ON), so instrumented code costs nothing
+// in normal builds; the functions below still exist and report empty results.
+typedef enum {
+    PROFILE_STEP,        // One BodySystem step call (an adaptive advance counts as one), also per method
+    PROFILE_FORCES,      // One force evaluation, including the tree build
+    PROFILE_TREE_BUILD,
+    PROFILE_SORT,        // Reordering the bodies along a space-filling curve (spatialsort.h)
+    PROFILE_STAGES,      // Stage combinations and kick/drift updates between force evaluations
+    PROFILE_DIAGNOSTICS,
+    PROFILE_SNAPSHOT,    // Publishing a snapshot to the viewer
+    PROFILE_RENDER,
+
+    PROFILE_ZONE_COUNT
+} ProfileZone;
+
+extern const char* profileZoneNames[PROFILE_ZONE_COUNT];
+
+typedef struct {
+    long long calls;
+    long long nanoseconds;
+} ProfileZoneStats;
+
+typedef struct {
+    long long steps;
+    long long bodySteps;        // Steps times bodies, for ns per body-step
+    long long forceEvaluations;
+    long long nanoseconds;
+} ProfileMethodStats;
+
+// Totals since the start or the last ResetProfile; subtract two snapshots for a rate
+typedef struct {
+    ProfileZoneStats zones[PROFILE_ZONE_COUNT];
+    ProfileMethodStats methods[METHOD_COUNT];
+} ProfileSnapshot;
+
+bool IsProfilingEnabled(void);
+
+long long GetProfileTime(void); // Nanoseconds
+void EndProfileZone(ProfileZone zone, long long start);
+void EndProfileStep(Method method, int bodies, long long forceEvaluations, long long start);
+
+void GetProfileSnapshot(ProfileSnapshot* snapshot);
+void ResetProfile(void);
+
+// Records every zone as a Chrome trace event (chrome://tracing, Perfetto) into a buffer of
+// capacity events, allocated on the first call; events past it are dropped and counted.
+bool StartProfileTrace(int capacity);
+bool IsProfileTracing(void);
+// Stops tracing and writes the events as Chrome trace JSON; returns the number dropped
+// through *dropped
+bool WriteProfileTrace(const char* path, long long* dropped);
+void UnloadProfileTrace(void);
+
+#if defined(GABRK_PROFILE)
+    #define PROFILE_BEGIN(zone) const long long profileStart_##zone = GetProfileTime()
+    #define PROFILE_END(zone) EndProfileZone(zone, profileStart_##zone)
+
+    // Brackets a BodySystem step, counting its force evaluations against the method
+    #define PROFILE_BEGIN_STEP(system) \
+        const long long profileStepStart = GetProfileTime(); \
+        const long long profileStepEvaluations = (system)->forceEvaluations
+    #define PROFILE_END_STEP(system, method) \
+        EndProfileStep(method, (system)->count, (system)->forceEvaluations - profileStepEvaluations, profileStepStart)
+#else
+    #define PROFILE_BEGIN(zone) ((void)0)
+    #define PROFILE_END(zone) ((void)0)
+    #define PROFILE_BEGIN_STEP(system) ((void)0)
+    #define PROFILE_END_STEP(system, method) ((void)0)
+#endif
+
+#endif
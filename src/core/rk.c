@@ -0,0 +1,226 @@
+#include "rk.h"
+#include "profiler.h"
+
+#include <tgmath.h>
+#include <string.h>
+
+typedef void (*StepFn)(Real* state, int dim, Real dt, DerivativeFn derivative, void* user, Real* scratch);
+
+// rkTableaus, one unrolled Step_<method> per tableau and the steppers table, generated from
+// rk_tableaus.def by tools/rkgen.c
+#include "rk_kernels.inc"
+
+// Trailing stages with a zero weight only feed the embedded solution or the next step
+// (FSAL), so a fixed step can skip them
+static int UsedStages(const ButcherTableau* tableau)
+{
+    int stages = tableau->stages;
+    while (stages > 1 && tableau->b[stages - 1] == 0.0) stages--;
+    return stages;
+}
+
+int GetRKScratchSize(int dim)
+{
+    int stages = 0;
+    for (int method = 0; method < RK_METHOD_COUNT; method++) {
+        if (rkTableaus[method].stages > stages) stages = rkTableaus[method].stages;
+    }
+    return (stages + 2) * dim;
+}
+
+void StepRK(Method method, Real* state, int dim, Real dt, DerivativeFn derivative, void* user, Real* scratch)
+{
+    steppers[method](state, dim, dt, derivative, user, scratch);
+}
+
+// out = base + sum(weights[t] * terms[t]), evaluated in the same order as the generated steppers
+typedef struct {
+    Real* out;
+    const Real* base;
+    const Real* terms[RK_MAX_STAGES];
+    Real weights[RK_MAX_STAGES];
+    int termCount;
+} Combination;
+
+static void CombineRange(int begin, int end, void* user)
+{
+    const Combination* combination = user;
+    Real* out = combination->out;
+
+    if (out != combination->base) {
+        for (int i = begin; i < end; i++) out[i] = combination->base[i];
+    }
+    for (int t = 0; t < combination->termCount; t++) {
+        const Real w = combination->weights[t];
+        const Real* v = combination->terms[t];
+        for (int i = begin; i < end; i++) out[i] += w * v[i];
+    }
+}
+
+void StepRKParallel(Method method, Real* state, int dim, Real dt, DerivativeFn derivative, void* user,
+                    Real* scratch, ThreadPool* pool)
+{
+    if (GetThreadPoolSize(pool) == 1) {
+        StepRK(method, state, dim, dt, derivative, user, scratch);
+        return;
+    }
+
+    const ButcherTableau* tableau = &rkTableaus[method];
+    Real* stage = scratch;
+    Real* k = scratch + dim;
+    const int stages = UsedStages(tableau);
+
+    for (int s = 0; s < stages; s++) {
+        const Real* input = state;
+
+        if (s > 0) {
+            PROFILE_BEGIN(PROFILE_STAGES);
+            Combination combination = { stage, state, { 0 }, { 0 }, 0 };
+            for (int j = 0; j < s; j++) {
+                const Real a = tableau->a[s][j];
+                if (a == 0.0) continue;
+                combination.terms[combination.termCount] = k + j * dim;
+                combination.weights[combination.termCount] = dt * a;
+                combination.termCount++;
+            }
+            ParallelFor(pool, dim, CombineRange, &combination);
+            input = stage;
+            PROFILE_END(PROFILE_STAGES);
+        }
+
+        derivative(input, k + s * dim, dim, user);
+    }
+
+    PROFILE_BEGIN(PROFILE_STAGES);
+    Combination update = { state, state, { 0 }, { 0 }, 0 };
+    for (int s = 0; s < stages; s++) {
+        const Real b = tableau->b[s];
+        if (b == 0.0) continue;
+        update.terms[update.termCount] = k + s * dim;
+        update.weights[update.termCount] = dt * b;
+        update.termCount++;
+    }
+    ParallelFor(pool, dim, CombineRange, &update);
+    PROFILE_END(PROFILE_STAGES);
+}
+
+AdaptiveController CreateAdaptiveController(Real dt, Real rtol, Real atol)
+{
+    AdaptiveController controller = { 0 };
+    controller.dt = dt;
+    controller.minDt = dt * 1e-6;
+    controller.rtol = rtol;
+    controller.atol = atol;
+    controller.safety = 0.9;
+    controller.minFactor = 0.2;
+    controller.maxFactor = 5.0;
+    controller.previousError = 1.0;
+    return controller;
+}
+
+void ResetAdaptiveController(AdaptiveController* controller, Real dt)
+{
+    controller->dt = dt;
+    controller->previousError = 1.0;
+    controller->firstStageValid = 0;
+}
+
+Real StepRKAdaptive(Method method, Real* state, int dim, DerivativeFn derivative, void* user, Real* scratch,
+                     AdaptiveController* controller)
+{
+    const ButcherTableau* tableau = &rkTableaus[method];
+    Real* stage = scratch;
+    Real* k = scratch + dim;
+    Real* next = k + tableau->stages * dim;
+
+    // Gustafsson's PI gains, scaled by the order of the error estimate
+    const int errorOrder = ((tableau->order < tableau->embeddedOrder) ? tableau->order : tableau->embeddedOrder) + 1;
+    const Real alpha = 0.7 / errorOrder;
+    const Real beta = 0.4 / errorOrder;
+
+    if (!controller->firstStageValid) derivative(state, k, dim, user);
+    controller->firstStageValid = 1; // k1 depends only on state, so it survives rejections
+
+    int rejectedThisStep = 0;
+    for (;;) {
+        const Real dt = controller->dt;
+
+        for (int s = 1; s < tableau->stages; s++) {
+            PROFILE_BEGIN(PROFILE_STAGES);
+            for (int i = 0; i < dim; i++) stage[i] = state[i];
+            for (int j = 0; j < s; j++) {
+                const Real a = tableau->a[s][j];
+                if (a == 0.0) continue;
+                const Real* kj = k + j * dim;
+                for (int i = 0; i < dim; i++) stage[i] += dt * a * kj[i];
+            }
+            PROFILE_END(PROFILE_STAGES);
+            derivative(stage, k + s * dim, dim, user);
+        }
+
+        // Accumulated in the same order as the stages, so for FSAL methods next matches
+        // the last stage input bit for bit and its derivative can be reused
+        PROFILE_BEGIN(PROFILE_STAGES);
+        double sum = 0.0;
+        for (int i = 0; i < dim; i++) {
+            Real y = state[i];
+            Real e = 0.0;
+            for (int s = 0; s < tableau->stages; s++) {
+                const Real ks = k[s * dim + i];
+                if (tableau->b[s] != 0.0) y += dt * tableau->b[s] * ks;
+                e += (tableau->b[s] - tableau->bHat[s]) * ks;
+            }
+            next[i] = y;
+
+            const Real scale = controller->atol + controller->rtol * fmax(fabs(state[i]), fabs(y));
+            const double ratio = (double)(dt * e) / scale;
+            sum += ratio * ratio;
+        }
+        const Real error = (Real)sqrt(sum / dim);
+        PROFILE_END(PROFILE_STAGES);
+
+        if (error <= 1.0 || dt <= controller->minDt) {
+            memcpy(state, next, dim * sizeof(Real));
+            if (tableau->fsal) memcpy(k, k + (tableau->stages - 1) * dim, dim * sizeof(Real));
+            else controller->firstStageValid = 0;
+
+            const Real clamped = fmax(error, 1e-10);
+            Real factor = controller->safety * pow(clamped, -alpha) * pow(controller->previousError, beta);
+            factor = fmin(fmax(factor, controller->minFactor), rejectedThisStep ? 1.0 : controller->maxFactor);
+
+            controller->previousError = fmax(error, 1e-4);
+            controller->dt = fmax(dt * factor, controller->minDt);
+            controller->accepted++;
+            return dt;
+        }
+
+        const Real factor = fmax(controller->safety * pow(error, -1.0 / errorOrder), controller->minFactor);
+        controller->dt = fmax(dt * factor, controller->minDt);
+        controller->rejected++;
+        rejectedThisStep = 1;
+    }
+}
+
+int IntegrateRKAdaptive(Method method, Real* state, int dim, Real duration, DerivativeFn derivative, void* user,
+                        Real* scratch, AdaptiveController* controller)
+{
+    int steps = 0;
+    Real remaining = duration;
+
+    while (remaining > 0.0) {
+        const Real proposed = controller->dt;
+        const int clipped = proposed > remaining;
+        if (clipped) controller->dt = remaining;
+
+        const Real taken = StepRKAdaptive(method, state, dim, derivative, user, scratch, controller);
+
+        // A step shortened to land on the end point says little about the natural step size
+        if (clipped && taken >= remaining) controller->dt = proposed;
+
+        remaining -= taken;
+        steps++;
+        if (remaining <= 1e-6 * duration) break;
+    }
+
+    return steps;
+}
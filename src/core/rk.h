@@ -0,0 +1,82 @@
+#ifndef GABRK_RK_H
+#define GABRK_RK_H
+
+#include "methods.h"
+#include "precision.h"
+#include "threadpool.h"
+
+#define RK_MAX_STAGES 7
+
+// Explicit Runge-Kutta method in Butcher form: a is strictly lower triangular. Embedded
+// pairs also carry bHat, the weights of the lower-order solution used for error control.
+// FSAL methods evaluate their last stage at the new state, so it doubles as the next
+// step's first stage.
+typedef struct {
+    const char* name;
+    int stages;
+    int order;
+    int embeddedOrder; // 0 if the method has no embedded solution
+    int fsal;
+    Real a[RK_MAX_STAGES][RK_MAX_STAGES];
+    Real b[RK_MAX_STAGES];
+    Real bHat[RK_MAX_STAGES];
+    Real c[RK_MAX_STAGES];
+} ButcherTableau;
+
+// Indexed by the Runge-Kutta entries of Method
+extern const ButcherTableau rkTableaus[RK_METHOD_COUNT];
+
+// Writes d(state)/dt into derivative; both arrays hold dim values
+typedef void (*DerivativeFn)(const Real* state, Real* derivative, int dim, void* user);
+
+// Number of Reals the steppers need in their scratch buffer for a state of dim values:
+// one stage input, the k vectors of the tableau with the most stages, and the adaptive
+// candidate. The steppers never allocate, so a buffer of this size is all they need.
+int GetRKScratchSize(int dim);
+
+// Advances state by one step of dt using the given method
+void StepRK(Method method, Real* state, int dim, Real dt, DerivativeFn derivative, void* user, Real* scratch);
+
+// Same step with the stage combinations split across the pool by index range. The
+// derivative is still called once per stage and may use the pool itself.
+void StepRKParallel(Method method, Real* state, int dim, Real dt, DerivativeFn derivative, void* user,
+                    Real* scratch, ThreadPool* pool);
+
+// Step-size controller for embedded methods. The error of a step is the RMS over the
+// state of (y - yHat) / (atol + rtol * |y|); a step is accepted when it is <= 1 and the
+// next dt follows a PI law on the current and previous accepted errors.
+typedef struct {
+    Real dt;        // Size of the next attempted step
+    Real minDt;     // Steps this small are accepted regardless of error
+    Real rtol;
+    Real atol;
+    Real safety;
+    Real minFactor;
+    Real maxFactor;
+    Real previousError;
+    int firstStageValid; // Scratch holds f(state) for the current state (FSAL or after a rejection)
+    long accepted;
+    long rejected;
+} AdaptiveController;
+
+AdaptiveController CreateAdaptiveController(Real dt, Real rtol, Real atol);
+
+// Must be called whenever the state is changed outside StepRKAdaptive, or the scratch
+// buffer is used by another stepper, since the cached first stage is then stale.
+void ResetAdaptiveController(AdaptiveController* controller, Real dt);
+
+// The cached first stage (dim values) inside the scratch buffer, valid while the
+// controller's firstStageValid is set; checkpoints save it along with the state
+static inline Real* GetRKFirstStage(Real* scratch, int dim) { return scratch + dim; }
+
+// Attempts steps of an embedded method until one is accepted and returns its size. The
+// scratch buffer must stay with the controller between calls for first-stage reuse.
+Real StepRKAdaptive(Method method, Real* state, int dim, DerivativeFn derivative, void* user, Real* scratch,
+                     AdaptiveController* controller);
+
+// Advances by exactly duration with adaptive steps, shortening the last one to land on
+// the end point. Returns the number of accepted steps.
+int IntegrateRKAdaptive(Method method, Real* state, int dim, Real duration, DerivativeFn derivative, void* user,
+                        Real* scratch, AdaptiveController* controller);
+
+#endif
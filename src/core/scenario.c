@@ -0,0 +1,472 @@
+#include "scenario.h"
+#include "allocator.h"
+#include "filemap.h"
+#include "gravity.h"
+
+#include <ctype.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tgmath.h>
+
+#define SCENARIO_MAGIC "GABRKSCN"
+#define SCENARIO_VERSION 1
+#define SCENARIO_DATA_OFFSET 64 // Keeps the value blocks aligned in the mapping
+#define SCENARIO_MAX_COUNT (1 << 26)
+#define SCENARIO_MAX_LINE 512
+#define SCENARIO_PI 3.14159265358979323846
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t valueSize; // 4 or 8: float or double, for the state and the masses alike
+    uint64_t count;
+    uint64_t dataOffset;
+} ScenarioHeader;
+
+const char* scenarioKindNames[SCENARIO_KIND_COUNT] = {
+    "two-body",
+    "plummer",
+    "disk",
+    "binaries",
+};
+
+int FindScenarioKind(const char* name)
+{
+    for (int kind = 0; kind < SCENARIO_KIND_COUNT; kind++) {
+        if (strcmp(name, scenarioKindNames[kind]) == 0) return kind;
+    }
+    return -1;
+}
+
+ScenarioSettings CreateScenarioSettings(ScenarioKind kind, int count)
+{
+    return (ScenarioSettings){
+        .kind = kind,
+        .count = (kind == SCENARIO_TWO_BODY) ? 2 : count,
+        .seed = 1,
+        .centerX = 400.0,
+        .centerY = 300.0,
+        .radius = 100.0,
+        .totalMass = 20.0,
+        .separation = 10.0,
+    };
+}
+
+// SplitMix64 finalizer, which also seeds each body's stream from (seed, index)
+static uint64_t MixBits(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+typedef struct {
+    uint64_t state;
+} BodyRandom;
+
+static BodyRandom SeedBodyRandom(uint64_t seed, uint64_t index)
+{
+    return (BodyRandom){ MixBits(seed ^ MixBits(index + 0x9E3779B97F4A7C15ull)) };
+}
+
+// Uniform in [0, 1)
+static double NextUniform(BodyRandom* random)
+{
+    random->state += 0x9E3779B97F4A7C15ull;
+    return (double)(MixBits(random->state) >> 11) * 0x1.0p-53;
+}
+
+// Speed of a circular orbit at distance r about mass m, with the kernels' softening
+static double GetCircularSpeed(double m, double r)
+{
+    const double eps2 = (double)GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+    return sqrt(GRAVITY_G * m * r * r / pow(r * r + eps2, 1.5));
+}
+
+static void SetBody(BodySystem* system, int i, double x, double y, double vx, double vy, double m)
+{
+    system->px[i] = (Real)x;
+    system->py[i] = (Real)y;
+    system->vx[i] = (Real)vx;
+    system->vy[i] = (Real)vy;
+    system->mass[i] = (ForceReal)m;
+}
+
+typedef struct {
+    const ScenarioSettings* settings;
+    BodySystem* system;
+} GeneratorJob;
+
+// Positions from the inverse of the cumulative mass, speeds by von Neumann rejection
+// from the distribution function, both in units G = M = a = 1 and then scaled
+static void PlummerRange(int begin, int end, void* user)
+{
+    const GeneratorJob* job = user;
+    const ScenarioSettings* settings = job->settings;
+    const double velocityScale = sqrt(GRAVITY_G * settings->totalMass / settings->radius);
+    const double m = settings->totalMass / settings->count;
+
+    for (int i = begin; i < end; i++) {
+        BodyRandom random = SeedBodyRandom(settings->seed, (uint64_t)i);
+
+        double r;
+        do {
+            r = 1.0 / sqrt(pow(NextUniform(&random), -2.0 / 3.0) - 1.0);
+        } while (!(r < 20.0)); // The far tail holds 0.02% of the mass; redraw it rather than scatter it
+        double z = 2.0 * NextUniform(&random) - 1.0;
+        double phi = 2.0 * SCENARIO_PI * NextUniform(&random);
+        const double x = r * sqrt(1.0 - z * z) * cos(phi);
+        const double y = r * sqrt(1.0 - z * z) * sin(phi);
+
+        double q, g;
+        do {
+            q = NextUniform(&random);
+            g = 0.1 * NextUniform(&random);
+        } while (g > q * q * pow(1.0 - q * q, 3.5));
+        const double speed = q * sqrt(2.0) * pow(1.0 + r * r, -0.25);
+        z = 2.0 * NextUniform(&random) - 1.0;
+        phi = 2.0 * SCENARIO_PI * NextUniform(&random);
+
+        SetBody(job->system, i, x * settings->radius, y * settings->radius, speed * sqrt(1.0 - z * z) * cos(phi) * velocityScale,
+                speed * sqrt(1.0 - z * z) * sin(phi) * velocityScale, m);
+    }
+}
+
+// A point uniform in the disk, moving counterclockwise on the circular orbit about the
+// mass inside its radius
+static void DrawDiskPoint(const ScenarioSettings* settings, BodyRandom* random, double* x, double* y, double* vx, double* vy)
+{
+    const double u = NextUniform(random);
+    const double r = settings->radius * sqrt(u);
+    const double angle = 2.0 * SCENARIO_PI * NextUniform(random);
+    const double speed = GetCircularSpeed(settings->totalMass * u, r);
+    *x = r * cos(angle);
+    *y = r * sin(angle);
+    *vx = -speed * sin(angle);
+    *vy = speed * cos(angle);
+}
+
+static void DiskRange(int begin, int end, void* user)
+{
+    const GeneratorJob* job = user;
+    const ScenarioSettings* settings = job->settings;
+    const double m = settings->totalMass / settings->count;
+
+    for (int i = begin; i < end; i++) {
+        BodyRandom random = SeedBodyRandom(settings->seed, (uint64_t)i);
+        double x, y, vx, vy;
+        DrawDiskPoint(settings, &random, &x, &y, &vx, &vy);
+        SetBody(job->system, i, x, y, vx, vy, m);
+    }
+}
+
+// Pair p holds bodies 2p and 2p + 1; an odd last body orbits the disk alone
+static void BinaryRange(int begin, int end, void* user)
+{
+    const GeneratorJob* job = user;
+    const ScenarioSettings* settings = job->settings;
+    const double m = settings->totalMass / settings->count;
+
+    for (int p = begin; p < end; p++) {
+        const int i = 2 * p;
+        BodyRandom random = SeedBodyRandom(settings->seed, (uint64_t)p);
+        double x, y, vx, vy;
+        DrawDiskPoint(settings, &random, &x, &y, &vx, &vy);
+        if (i + 1 == settings->count) {
+            SetBody(job->system, i, x, y, vx, vy, m);
+            continue;
+        }
+
+        const double d = settings->separation * pow(10.0, -NextUniform(&random));
+        const double angle = 2.0 * SCENARIO_PI * NextUniform(&random);
+        const double speed = 0.5 * GetCircularSpeed(2.0 * m, d);
+        const double cx = 0.5 * d * cos(angle), cy = 0.5 * d * sin(angle);
+        const double cvx = -speed * sin(angle), cvy = speed * cos(angle);
+        SetBody(job->system, i, x + cx, y + cy, vx + cvx, vy + cvy, m);
+        SetBody(job->system, i + 1, x - cx, y - cy, vx - cvx, vy - cvy, m);
+    }
+}
+
+// Moves the centre of mass to the scenario's centre and takes out its motion
+static void CenterBodies(BodySystem* system, const ScenarioSettings* settings)
+{
+    double mass = 0.0, x = 0.0, y = 0.0, vx = 0.0, vy = 0.0;
+    for (int i = 0; i < system->count; i++) {
+        const double m = system->mass[i];
+        mass += m;
+        x += m * system->px[i];
+        y += m * system->py[i];
+        vx += m * system->vx[i];
+        vy += m * system->vy[i];
+    }
+    if (!(mass > 0.0)) return;
+
+    const double offsetX = settings->centerX - x / mass, offsetY = settings->centerY - y / mass;
+    for (int i = 0; i < system->count; i++) {
+        system->px[i] = (Real)(system->px[i] + offsetX);
+        system->py[i] = (Real)(system->py[i] + offsetY);
+        system->vx[i] = (Real)(system->vx[i] - vx / mass);
+        system->vy[i] = (Real)(system->vy[i] - vy / mass);
+    }
+}
+
+BodySystem GenerateScenario(const ScenarioSettings* settings, ThreadPool* pool)
+{
+    if (settings->kind == SCENARIO_TWO_BODY) {
+        BodySystem system = LoadBodySystem(2);
+        if (system.count > 0) ResetTwoBodyOrbit(&system);
+        return system;
+    }
+    if (settings->count <= 0 || settings->count > SCENARIO_MAX_COUNT || (unsigned)settings->kind >= SCENARIO_KIND_COUNT) {
+        return (BodySystem){ 0 };
+    }
+
+    BodySystem system = LoadBodySystem(settings->count);
+    if (system.count == 0) return system;
+
+    GeneratorJob job = { settings, &system };
+    switch (settings->kind)
+    {
+        case SCENARIO_PLUMMER: ParallelFor(pool, system.count, PlummerRange, &job); break;
+        case SCENARIO_DISK: ParallelFor(pool, system.count, DiskRange, &job); break;
+        case SCENARIO_BINARIES: ParallelFor(pool, (system.count + 1) / 2, BinaryRange, &job); break;
+        default: break;
+    }
+    CenterBodies(&system, settings);
+    return system;
+}
+
+static void CopyRealValues(Real* target, const unsigned char* source, size_t valueSize, int n)
+{
+    if (valueSize == sizeof(Real)) {
+        memcpy(target, source, n * sizeof(Real));
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        if (valueSize == sizeof(float)) {
+            float value;
+            memcpy(&value, source + i * sizeof(float), sizeof(float));
+            target[i] = (Real)value;
+        }
+        else {
+            double value;
+            memcpy(&value, source + i * sizeof(double), sizeof(double));
+            target[i] = (Real)value;
+        }
+    }
+}
+
+static void CopyForceRealValues(ForceReal* target, const unsigned char* source, size_t valueSize, int n)
+{
+    if (valueSize == sizeof(ForceReal)) {
+        memcpy(target, source, n * sizeof(ForceReal));
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        if (valueSize == sizeof(float)) {
+            float value;
+            memcpy(&value, source + i * sizeof(float), sizeof(float));
+            target[i] = (ForceReal)value;
+        }
+        else {
+            double value;
+            memcpy(&value, source + i * sizeof(double), sizeof(double));
+            target[i] = (ForceReal)value;
+        }
+    }
+}
+
+typedef struct {
+    const unsigned char* values;
+    size_t valueSize;
+    BodySystem* system;
+} CopyJob;
+
+// Every thread copies its range of bodies from all five blocks, so the page faults of a
+// cold mapping are spread over the pool too
+static void CopyRange(int begin, int end, void* user)
+{
+    const CopyJob* job = user;
+    const int count = job->system->count;
+    const size_t blockSize = (size_t)count * job->valueSize;
+    const size_t offset = (size_t)begin * job->valueSize;
+
+    for (int block = 0; block < 4; block++) {
+        CopyRealValues(job->system->state + (size_t)block * count + begin, job->values + block * blockSize + offset,
+                       job->valueSize, end - begin);
+    }
+    CopyForceRealValues(job->system->mass + begin, job->values + 4 * blockSize + offset, job->valueSize, end - begin);
+}
+
+static BodySystem LoadBinaryScenario(const unsigned char* data, size_t size, ThreadPool* pool)
+{
+    ScenarioHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.version != SCENARIO_VERSION || (header.valueSize != sizeof(float) && header.valueSize != sizeof(double)) ||
+        header.count == 0 || header.count > SCENARIO_MAX_COUNT || header.dataOffset < sizeof(header) ||
+        header.dataOffset > size || (size - header.dataOffset) / 5 / header.valueSize < header.count) {
+        return (BodySystem){ 0 };
+    }
+
+    BodySystem system = LoadBodySystem((int)header.count);
+    if (system.count == 0) return system;
+
+    CopyJob job = { data + header.dataOffset, header.valueSize, &system };
+    ParallelFor(pool, system.count, CopyRange, &job);
+    return system;
+}
+
+// Whether a line holds anything but blanks or a '#' comment
+static bool IsContentLine(const unsigned char* line, const unsigned char* end)
+{
+    while (line < end && isspace(*line)) line++;
+    return line < end && *line != '#';
+}
+
+// Reads "x y vx vy mass", separated by blanks or commas, from a line without its newline;
+// false unless the line is exactly five numbers
+static bool ParseBodyLine(const unsigned char* text, size_t length, double values[5])
+{
+    // strtod needs a terminated string, which the mapping does not have
+    char line[SCENARIO_MAX_LINE];
+    if (length >= sizeof(line)) return false;
+    memcpy(line, text, length);
+    line[length] = '\0';
+    for (char* c = line; *c; c++) {
+        if (*c == ',') *c = ' ';
+    }
+
+    char* cursor = line;
+    for (int v = 0; v < 5; v++) {
+        char* next;
+        values[v] = strtod(cursor, &next);
+        if (next == cursor) return false;
+        cursor = next;
+    }
+    while (isspace((unsigned char)*cursor)) cursor++;
+    return *cursor == '\0';
+}
+
+static size_t GetLineLength(const unsigned char* data, size_t size, size_t start)
+{
+    const unsigned char* newline = memchr(data + start, '\n', size - start);
+    return newline ? (size_t)(newline - data) - start : size - start;
+}
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    const size_t* lineStarts;
+    BodySystem* system;
+    atomic_int failed;
+} ParseJob;
+
+static void ParseRange(int begin, int end, void* user)
+{
+    ParseJob* job = user;
+
+    for (int i = begin; i < end; i++) {
+        const size_t start = job->lineStarts[i];
+        double values[5];
+        if (!ParseBodyLine(job->data + start, GetLineLength(job->data, job->size, start), values)) {
+            atomic_store_explicit(&job->failed, 1, memory_order_relaxed);
+            return;
+        }
+        SetBody(job->system, i, values[0], values[1], values[2], values[3], values[4]);
+    }
+}
+
+// Finds the body lines in one serial pass, then parses them across the pool. The first
+// line with content is a header unless it parses as a body; every later one is a body.
+static BodySystem LoadTextScenario(const unsigned char* data, size_t size, ThreadPool* pool)
+{
+    size_t* lineStarts = NULL;
+    int count = 0;
+
+    // The first pass counts the body lines, the second records where they start
+    for (int pass = 0; pass < 2; pass++) {
+        int line = 0;
+        bool first = true;
+        for (size_t start = 0; start < size;) {
+            const size_t length = GetLineLength(data, size, start);
+            if (IsContentLine(data + start, data + start + length)) {
+                double values[5];
+                const bool header = first && !ParseBodyLine(data + start, length, values);
+                first = false;
+                if (!header) {
+                    if (pass == 1) lineStarts[line] = start;
+                    line++;
+                }
+            }
+            start += length + 1;
+        }
+
+        if (pass == 0) {
+            count = line;
+            if (count == 0 || count > SCENARIO_MAX_COUNT) return (BodySystem){ 0 };
+            lineStarts = CoreAlloc(count * sizeof(size_t));
+            if (!lineStarts) return (BodySystem){ 0 };
+        }
+    }
+
+    BodySystem system = LoadBodySystem(count);
+    if (system.count > 0) {
+        ParseJob job = { data, size, lineStarts, &system, 0 };
+        ParallelFor(pool, count, ParseRange, &job);
+        if (atomic_load(&job.failed)) {
+            UnloadBodySystem(system);
+            system = (BodySystem){ 0 };
+        }
+    }
+    CoreFree(lineStarts);
+    return system;
+}
+
+BodySystem LoadScenario(const char* path, ThreadPool* pool)
+{
+    size_t size = 0;
+    const unsigned char* data = MapFile(path, &size);
+    if (!data) return (BodySystem){ 0 };
+
+    const bool binary = size >= sizeof(ScenarioHeader) && memcmp(data, SCENARIO_MAGIC, 8) == 0;
+    BodySystem system = binary ? LoadBinaryScenario(data, size, pool) : LoadTextScenario(data, size, pool);
+    UnmapFile(data, size);
+    return system;
+}
+
+bool WriteScenario(const char* path, const BodySystem* system)
+{
+    const int count = system->count;
+    const int dim = GetBodySystemDim(system);
+    Real* state = CoreAlloc((dim + count) * sizeof(Real)); // The masses go out as Reals after the state
+    ForceReal* mass = CoreAlloc(count * sizeof(ForceReal));
+    FILE* file = (state && mass) ? fopen(path, "wb") : NULL;
+    if (!file) {
+        CoreFree(state);
+        CoreFree(mass);
+        return false;
+    }
+
+    CopyBodiesById(system, state, mass);
+    for (int i = 0; i < count; i++) state[dim + i] = (Real)mass[i];
+
+    ScenarioHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCENARIO_MAGIC, sizeof(header.magic));
+    header.version = SCENARIO_VERSION;
+    header.valueSize = sizeof(Real);
+    header.count = (uint64_t)count;
+    header.dataOffset = SCENARIO_DATA_OFFSET;
+
+    unsigned char padding[SCENARIO_DATA_OFFSET] = { 0 };
+    memcpy(padding, &header, sizeof(header));
+    bool ok = fwrite(padding, 1, sizeof(padding), file) == sizeof(padding) &&
+              fwrite(state, sizeof(Real), dim + count, file) == (size_t)(dim + count);
+    ok = (fclose(file) == 0) && ok;
+
+    CoreFree(state);
+    CoreFree(mass);
+    return ok;
+}
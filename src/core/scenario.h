@@ -0,0 +1,56 @@
+#ifndef GABRK_SCENARIO_H
+#define GABRK_SCENARIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bodies.h"
+#include "threadpool.h"
+
+typedef enum {
+    SCENARIO_TWO_BODY,  // The viewer's default orbit (ResetTwoBodyOrbit), always two bodies
+    SCENARIO_PLUMMER,   // Plummer sphere (Aarseth, Henon and Wielen 1974) projected onto the plane
+    SCENARIO_DISK,      // Uniform disk on circular orbits about the mass inside each radius
+    SCENARIO_BINARIES,  // Circular binaries of random size and orientation spread over such a disk
+
+    SCENARIO_KIND_COUNT
+} ScenarioKind;
+
+extern const char* scenarioKindNames[SCENARIO_KIND_COUNT];
+
+// Index of the kind with this name, or -1
+int FindScenarioKind(const char* name);
+
+typedef struct {
+    ScenarioKind kind;
+    int count;
+    uint64_t seed;
+    double centerX;
+    double centerY;
+    double radius;      // Plummer scale radius, or the radius of the disk
+    double totalMass;   // Shared equally by the bodies
+    double separation;  // Widest binary; separations are log-uniform down to a tenth of it
+} ScenarioSettings;
+
+// Defaults centred in the viewer's window, at the scale of its two-body orbit
+ScenarioSettings CreateScenarioSettings(ScenarioKind kind, int count);
+
+// Every body draws from its own random stream, seeded from the seed and its index, so the
+// bodies are generated in parallel across the pool and come out the same for any pool
+// size, including none. The centre of mass is moved to the centre and set at rest.
+// Returns a system with count 0 on failure.
+BodySystem GenerateScenario(const ScenarioSettings* settings, ThreadPool* pool);
+
+// Files written by WriteScenario are mapped and their blocks copied straight into the
+// state, split across the pool. Any other file is read as text: one "x y vx vy mass" body
+// per line, separated by spaces, tabs or commas (so --state output loads back), skipping
+// blank lines, '#' comments and a header on the first line. Returns a system with count 0
+// if the file is missing or any other line is not a body.
+BodySystem LoadScenario(const char* path, ThreadPool* pool);
+
+// Binary scenario at the build's precision: a header, then the x, y, vx, vy and mass
+// blocks with the bodies in their original order (ids). Values are stored in the host's
+// byte order and converted on load when the precision differs.
+bool WriteScenario(const char* path, const BodySystem* system);
+
+#endif
@@ -0,0 +1,272 @@
+#if !defined(_WIN32)
+    #define _POSIX_C_SOURCE 200809L // nanosleep
+#endif
+
+#include "simthread.h"
+#include "allocator.h"
+#include "clock.h"
+#include "diagnostics.h"
+#include "profiler.h"
+#include "triplebuffer.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#define SIM_COMMAND_CAPACITY 64 // Power of two
+
+struct SimThread {
+    pthread_t thread;
+    atomic_bool stop;
+
+    // Owned by the simulation thread once it starts
+    BodySystem bodies;
+    Method method;
+    FixedTimestep timestep;
+    AdaptiveController controller;
+    Arena workspace;
+    Real* initial;  // State restored by SIM_RESET
+    Real* previous; // Positions the snapshot interpolates from
+    double previousTime;
+
+    // Single-producer, single-consumer ring from the render thread
+    SimCommand commands[SIM_COMMAND_CAPACITY];
+    atomic_uint commandHead;
+    atomic_uint commandTail;
+
+    SimSnapshot snapshots[3];
+    TripleBuffer handoff;
+};
+
+static void SleepSeconds(double seconds)
+{
+#if defined(_WIN32)
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    const struct timespec ts = { (time_t)seconds, (long)((seconds - floor(seconds)) * 1e9) };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void SavePrevious(SimThread* thread)
+{
+    memcpy(thread->previous, thread->bodies.state, 2 * thread->bodies.count * sizeof(Real));
+    thread->previousTime = thread->timestep.time;
+}
+
+static void StepSimulation(double dt, void* user)
+{
+    SimThread* thread = user;
+    BodySystem* bodies = &thread->bodies;
+
+    // Real time interpolates across the last step, fixed substeps across the whole tick
+    if (thread->timestep.mode == TIMESTEP_REAL_TIME) SavePrevious(thread);
+
+    // Embedded methods cover each fixed step in as many adaptive steps as they need
+    if (IsEmbeddedMethod(thread->method)) AdvanceBodySystemAdaptive(bodies, thread->method, &thread->controller, (Real)dt);
+    else StepBodySystem(bodies, thread->method, (Real)dt);
+}
+
+static void PublishSnapshot(SimThread* thread, int steps)
+{
+    PROFILE_BEGIN(PROFILE_SNAPSHOT);
+    BodySystem* bodies = &thread->bodies;
+    const FixedTimestep* timestep = &thread->timestep;
+    SimSnapshot* snapshot = &thread->snapshots[GetTripleBufferWriteSlot(&thread->handoff)];
+
+    memcpy(snapshot->previous, thread->previous, 2 * bodies->count * sizeof(Real));
+    memcpy(snapshot->current, bodies->state, 2 * bodies->count * sizeof(Real));
+
+    snapshot->method = thread->method;
+    snapshot->mode = timestep->mode;
+    snapshot->dt = timestep->dt;
+    snapshot->substeps = timestep->substeps;
+    snapshot->time = timestep->time;
+    snapshot->steps = timestep->steps;
+    snapshot->stepsLastTick = steps;
+
+    const Diagnostics diagnostics = ComputeDiagnostics(bodies);
+    snapshot->kineticEnergy = diagnostics.kineticEnergy;
+    snapshot->potentialEnergy = diagnostics.potentialEnergy;
+    snapshot->adaptiveDt = thread->controller.dt;
+    snapshot->accepted = thread->controller.accepted;
+    snapshot->rejected = thread->controller.rejected;
+
+    if (timestep->mode == TIMESTEP_REAL_TIME) {
+        snapshot->alpha = GetTimestepAlpha(timestep);
+        snapshot->alphaRate = timestep->timeScale / timestep->dt;
+    }
+    else {
+        // The next tick covers as much simulated time as this one, spread over a tick
+        const double interval = timestep->time - thread->previousTime;
+        snapshot->alpha = 0.0;
+        snapshot->alphaRate = (interval > 0.0) ? timestep->substeps * timestep->dt / SIM_TICK_SECONDS / interval : 0.0;
+    }
+    snapshot->publishSeconds = GetClockSeconds();
+
+    PublishTripleBuffer(&thread->handoff);
+    PROFILE_END(PROFILE_SNAPSHOT);
+}
+
+static void ResetSimulation(SimThread* thread)
+{
+    BodySystem* bodies = &thread->bodies;
+    memcpy(bodies->state, thread->initial, GetBodySystemDim(bodies) * sizeof(Real));
+    bodies->accelerationsValid = 0;
+
+    ResetAdaptiveController(&thread->controller, (Real)thread->timestep.dt);
+    thread->timestep.accumulator = 0.0;
+    thread->timestep.time = 0.0;
+    thread->timestep.steps = 0;
+    SavePrevious(thread);
+}
+
+// Returns whether any command was applied
+static bool ApplyCommands(SimThread* thread)
+{
+    const unsigned head = atomic_load_explicit(&thread->commandHead, memory_order_acquire);
+    unsigned tail = atomic_load_explicit(&thread->commandTail, memory_order_relaxed);
+    if (tail == head) return false;
+
+    for (; tail != head; tail++) {
+        const SimCommand command = thread->commands[tail & (SIM_COMMAND_CAPACITY - 1)];
+        switch (command.type)
+        {
+            case SIM_SET_METHOD:
+                thread->method = (Method)command.value;
+                ResetAdaptiveController(&thread->controller, (Real)thread->timestep.dt); // Its cached stage is stale
+                break;
+            case SIM_SET_DT:
+                thread->timestep.dt = command.value;
+                thread->timestep.accumulator = 0.0;
+                ResetAdaptiveController(&thread->controller, (Real)command.value);
+                break;
+            case SIM_SET_MODE:
+                thread->timestep.mode = (TimestepMode)command.value;
+                thread->timestep.accumulator = 0.0;
+                break;
+            case SIM_SET_SUBSTEPS:
+                thread->timestep.substeps = (command.value >= 1.0) ? (int)command.value : 1;
+                break;
+            case SIM_RESET:
+                ResetSimulation(thread);
+                break;
+        }
+    }
+
+    atomic_store_explicit(&thread->commandTail, tail, memory_order_release);
+    return true;
+}
+
+static void* SimThreadMain(void* arg)
+{
+    SimThread* thread = arg;
+    double last = GetClockSeconds();
+    double nextTick = last + SIM_TICK_SECONDS;
+
+    while (!atomic_load_explicit(&thread->stop, memory_order_acquire)) {
+        const bool changed = ApplyCommands(thread);
+
+        const double now = GetClockSeconds();
+        if (thread->timestep.mode == TIMESTEP_FIXED_SUBSTEPS) SavePrevious(thread);
+        const int steps = AdvanceFixedTimestep(&thread->timestep, now - last, StepSimulation, thread);
+        last = now;
+        if (steps > 0 || changed) PublishSnapshot(thread, steps);
+
+        // Ticks that overran start the next one right away instead of trying to catch up
+        const double wait = nextTick - GetClockSeconds();
+        if (wait > 0.0) SleepSeconds(wait);
+        nextTick = fmax(nextTick + SIM_TICK_SECONDS, GetClockSeconds());
+    }
+    return NULL;
+}
+
+SimThread* CreateSimThread(BodySystem bodies, Method method, FixedTimestep timestep, AdaptiveController controller)
+{
+    const size_t positionsSize = 2 * bodies.count * sizeof(Real);
+    const size_t workspaceSize = GetArenaPushSize(2 * positionsSize) + 7 * GetArenaPushSize(positionsSize);
+
+    SimThread* thread = CoreCalloc(1, sizeof(SimThread));
+    if (!thread) return NULL;
+    thread->workspace = LoadArena(workspaceSize);
+    if (!thread->workspace.base) {
+        CoreFree(thread);
+        return NULL;
+    }
+
+    thread->bodies = bodies;
+    thread->bodies.potentialRequested = DIAGNOSTICS_KERNEL_POTENTIAL; // Every tick publishes energies
+    thread->method = method;
+    thread->timestep = timestep;
+    thread->controller = controller;
+    thread->initial = PushArena(&thread->workspace, 2 * positionsSize);
+    thread->previous = PushArena(&thread->workspace, positionsSize);
+    memcpy(thread->initial, bodies.state, 2 * positionsSize);
+    memcpy(thread->previous, bodies.state, positionsSize);
+
+    for (int i = 0; i < 3; i++) {
+        thread->snapshots[i].count = bodies.count;
+        thread->snapshots[i].previous = PushArena(&thread->workspace, positionsSize);
+        thread->snapshots[i].current = PushArena(&thread->workspace, positionsSize);
+    }
+
+    atomic_init(&thread->stop, false);
+    atomic_init(&thread->commandHead, 0u);
+    atomic_init(&thread->commandTail, 0u);
+    InitTripleBuffer(&thread->handoff);
+    PublishSnapshot(thread, 0);
+
+    if (pthread_create(&thread->thread, NULL, SimThreadMain, thread) != 0) {
+        UnloadArena(thread->workspace);
+        CoreFree(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void DestroySimThread(SimThread* thread)
+{
+    if (!thread) return;
+
+    atomic_store_explicit(&thread->stop, true, memory_order_release);
+    pthread_join(thread->thread, NULL);
+
+    UnloadBodySystem(thread->bodies);
+    UnloadArena(thread->workspace);
+    CoreFree(thread);
+}
+
+bool SendSimCommand(SimThread* thread, SimCommand command)
+{
+    return SendSimCommands(thread, &command, 1);
+}
+
+bool SendSimCommands(SimThread* thread, const SimCommand* commands, int count)
+{
+    const unsigned head = atomic_load_explicit(&thread->commandHead, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&thread->commandTail, memory_order_acquire);
+    if (count < 0 || head - tail + (unsigned)count > SIM_COMMAND_CAPACITY) return false;
+
+    // One release store publishes them all, so the simulation thread sees all or none
+    for (int i = 0; i < count; i++) thread->commands[(head + i) & (SIM_COMMAND_CAPACITY - 1)] = commands[i];
+    atomic_store_explicit(&thread->commandHead, head + (unsigned)count, memory_order_release);
+    return true;
+}
+
+const SimSnapshot* AcquireSimSnapshot(SimThread* thread)
+{
+    return &thread->snapshots[AcquireTripleBuffer(&thread->handoff, NULL)];
+}
+
+double GetSimSnapshotAlpha(const SimSnapshot* snapshot)
+{
+    const double alpha = snapshot->alpha + (GetClockSeconds() - snapshot->publishSeconds) * snapshot->alphaRate;
+    return (alpha < 1.0) ? alpha : 1.0;
+}
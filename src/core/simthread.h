@@ -0,0 +1,78 @@
+#ifndef GABRK_SIMTHREAD_H
+#define GABRK_SIMTHREAD_H
+
+#include <stdbool.h>
+
+#include "bodies.h"
+#include "timestep.h"
+
+#define SIM_TICK_SECONDS (1.0 / 120.0) // How often the simulation thread wakes to step
+
+typedef enum {
+    SIM_SET_METHOD,   // value: Method
+    SIM_SET_DT,       // value: step size, keeping the time scale
+    SIM_SET_MODE,     // value: TimestepMode
+    SIM_SET_SUBSTEPS, // value: steps per tick with TIMESTEP_FIXED_SUBSTEPS
+    SIM_RESET,        // Back to the initial state and time 0
+} SimCommandType;
+
+typedef struct {
+    SimCommandType type;
+    double value;
+} SimCommand;
+
+// What the simulation thread publishes after each tick that stepped. Positions are the
+// x block then the y block, before and after the last step in real time, or before and
+// after the whole tick with fixed substeps.
+typedef struct {
+    int count;
+    Real* previous;
+    Real* current;
+
+    Method method;
+    TimestepMode mode;
+    double dt;
+    int substeps;
+    double time;
+    long long steps;
+    int stepsLastTick;
+
+    double kineticEnergy;
+    double potentialEnergy;
+    Real adaptiveDt;
+    long accepted;
+    long rejected;
+
+    // Where the clock stood between previous and current when this was published, and
+    // how fast it moves on, in previous-to-current intervals per wall-clock second, for
+    // interpolating past it
+    double alpha;
+    double alphaRate;
+    double publishSeconds;
+} SimSnapshot;
+
+typedef struct SimThread SimThread;
+
+// Takes ownership of the bodies, whose current state becomes the one SIM_RESET
+// restores, and starts stepping them with the given method and clock; the controller is
+// used by embedded methods. Returns NULL on failure, in which case the bodies are still
+// the caller's.
+SimThread* CreateSimThread(BodySystem bodies, Method method, FixedTimestep timestep, AdaptiveController controller);
+// Stops and joins the thread, then unloads the bodies
+void DestroySimThread(SimThread* thread);
+
+// Queues a command for the start of the next tick. Never blocks; returns false if the
+// queue is full.
+bool SendSimCommand(SimThread* thread, SimCommand command);
+// Queues all of the commands, applied in order in the same tick, or none of them if the
+// queue cannot hold them all
+bool SendSimCommands(SimThread* thread, const SimCommand* commands, int count);
+
+// Latest published snapshot, without blocking. It stays valid and unchanged until the
+// next call, which must come from the same thread.
+const SimSnapshot* AcquireSimSnapshot(SimThread* thread);
+
+// Interpolation factor for rendering the snapshot now, in [0, 1]
+double GetSimSnapshotAlpha(const SimSnapshot* snapshot);
+
+#endif
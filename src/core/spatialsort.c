@@ -0,0 +1,150 @@
+#include "spatialsort.h"
+#include "profiler.h"
+#include "rk.h"
+
+#include <string.h>
+#include <tgmath.h>
+
+#define CURVE_BITS 16
+#define CURVE_SIZE (1u << CURVE_BITS)
+
+const char* spatialOrderNames[SPATIAL_ORDER_COUNT] = {
+    "Morton",
+    "Hilbert",
+};
+
+// Spreads the low 16 bits of v to the even bit positions
+static uint32_t SpreadBits(uint32_t v)
+{
+    v &= 0xFFFFu;
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+uint32_t GetMortonKey(uint32_t x, uint32_t y)
+{
+    return SpreadBits(x) | (SpreadBits(y) << 1);
+}
+
+// Walks the quadrants from the largest down, rotating the frame so each sub-curve
+// enters where the previous one left (the classic xy2d conversion)
+uint32_t GetHilbertKey(uint32_t x, uint32_t y)
+{
+    uint32_t key = 0;
+    for (uint32_t s = CURVE_SIZE / 2; s > 0; s /= 2) {
+        const uint32_t rx = (x & s) > 0;
+        const uint32_t ry = (y & s) > 0;
+        key += s * s * ((3 * rx) ^ ry);
+
+        if (ry == 0) {
+            if (rx == 1) {
+                x = CURVE_SIZE - 1 - x;
+                y = CURVE_SIZE - 1 - y;
+            }
+            const uint32_t t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return key;
+}
+
+// Positions outside the box, including NaN, go to the nearest edge
+static uint32_t Quantize(Real position, double origin, double scale)
+{
+    const double cell = ((double)position - origin) * scale;
+    if (cell >= 0.0 && cell < (double)CURVE_SIZE) return (uint32_t)cell;
+    return (cell >= (double)CURVE_SIZE) ? CURVE_SIZE - 1 : 0;
+}
+
+// Fills keys with the curve index of every body over the square around their bounding box
+static void ComputeKeys(const BodySystem* system, SpatialOrder order, uint32_t* keys)
+{
+    const int count = system->count;
+    double minX = system->px[0], maxX = system->px[0];
+    double minY = system->py[0], maxY = system->py[0];
+    for (int i = 1; i < count; i++) {
+        minX = fmin(minX, (double)system->px[i]);
+        maxX = fmax(maxX, (double)system->px[i]);
+        minY = fmin(minY, (double)system->py[i]);
+        maxY = fmax(maxY, (double)system->py[i]);
+    }
+
+    const double extent = fmax(maxX - minX, maxY - minY);
+    const double scale = (extent > 0.0 && isfinite(extent)) ? (CURVE_SIZE - 1) / extent : 0.0;
+
+    for (int i = 0; i < count; i++) {
+        const uint32_t x = Quantize(system->px[i], minX, scale);
+        const uint32_t y = Quantize(system->py[i], minY, scale);
+        keys[i] = (order == SPATIAL_ORDER_HILBERT) ? GetHilbertKey(x, y) : GetMortonKey(x, y);
+    }
+}
+
+// LSD radix sort of the keys in four stable counting-sort passes of eight bits. Returns
+// the body order: position i of the sorted system takes body order[i].
+static const int* SortKeys(BodySystem* system, uint32_t* keys)
+{
+    const int count = system->count;
+    uint32_t* otherKeys = keys + count;
+    int* order = system->sortIndices;
+    int* otherOrder = system->sortIndices + count;
+    for (int i = 0; i < count; i++) order[i] = i;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        int offsets[257] = { 0 };
+        for (int i = 0; i < count; i++) offsets[((keys[i] >> shift) & 0xFFu) + 1]++;
+        if (offsets[((keys[0] >> shift) & 0xFFu) + 1] == count) continue; // Every key shares this digit
+
+        for (int digit = 0; digit < 256; digit++) offsets[digit + 1] += offsets[digit];
+        for (int i = 0; i < count; i++) {
+            const int slot = offsets[(keys[i] >> shift) & 0xFFu]++;
+            otherKeys[slot] = keys[i];
+            otherOrder[slot] = order[i];
+        }
+
+        uint32_t* swapKeys = keys;
+        keys = otherKeys;
+        otherKeys = swapKeys;
+        int* swapOrder = order;
+        order = otherOrder;
+        otherOrder = swapOrder;
+    }
+    return order;
+}
+
+// data[i] = old data[order[i]] for count elements of the given size
+static void PermuteArray(void* data, size_t size, const int* order, int count, void* buffer)
+{
+    unsigned char* bytes = data;
+    unsigned char* staged = buffer;
+    for (int i = 0; i < count; i++) memcpy(staged + (size_t)i * size, bytes + (size_t)order[i] * size, size);
+    memcpy(bytes, staged, (size_t)count * size);
+}
+
+void SortBodySystem(BodySystem* system, SpatialOrder order)
+{
+    const int count = system->count;
+    if (count < 2) return;
+
+    PROFILE_BEGIN(PROFILE_SORT);
+    const int dim = GetBodySystemDim(system);
+    ComputeKeys(system, order, system->sortKeys);
+    const int* bodyOrder = SortKeys(system, system->sortKeys);
+
+    // The state and the first stage are four blocks each; accelerations are two
+    Real* first = GetRKFirstStage(system->scratch, dim);
+    for (int block = 0; block < 4; block++) {
+        PermuteArray(system->state + block * count, sizeof(Real), bodyOrder, count, system->sortBuffer);
+        PermuteArray(first + block * count, sizeof(Real), bodyOrder, count, system->sortBuffer);
+    }
+    for (int block = 0; block < 2; block++) {
+        PermuteArray(system->accelerations + block * count, sizeof(Real), bodyOrder, count, system->sortBuffer);
+    }
+    PermuteArray(system->mass, sizeof(ForceReal), bodyOrder, count, system->sortBuffer);
+    PermuteArray(system->potentials, sizeof(ForceReal), bodyOrder, count, system->sortBuffer);
+    PermuteArray(system->ids, sizeof(int), bodyOrder, count, system->sortBuffer);
+    PROFILE_END(PROFILE_SORT);
+}
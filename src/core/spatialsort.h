@@ -0,0 +1,32 @@
+#ifndef GABRK_SPATIALSORT_H
+#define GABRK_SPATIALSORT_H
+
+#include "bodies.h"
+
+#include <stdint.h>
+
+// Space-filling curves for SortBodySystem. Hilbert keeps every step along the curve
+// between neighbouring cells; Morton (Z-order) is cheaper to compute but jumps at
+// quadrant boundaries.
+typedef enum {
+    SPATIAL_ORDER_MORTON,
+    SPATIAL_ORDER_HILBERT,
+
+    SPATIAL_ORDER_COUNT
+} SpatialOrder;
+
+extern const char* spatialOrderNames[SPATIAL_ORDER_COUNT];
+
+// Curve index of a cell of the 65536 x 65536 grid
+uint32_t GetMortonKey(uint32_t x, uint32_t y);
+uint32_t GetHilbertKey(uint32_t x, uint32_t y);
+
+// Reorders the bodies along the curve through their positions, so bodies close in space
+// are close in memory and the force solvers touch fewer cache lines. Every per-body array
+// moves with them: state, masses, ids, the acceleration and potential caches and the
+// adaptive first stage, so no cache is invalidated and the step after a sort needs no
+// extra force evaluation. Uses the system's workspace and never allocates. Sums then run
+// in the new order, so trajectories differ from unsorted runs by rounding.
+void SortBodySystem(BodySystem* system, SpatialOrder order);
+
+#endif
@@ -0,0 +1,58 @@
+#include "symplectic.h"
+#include "profiler.h"
+
+// Yoshida (1990) triple jump, identical to Forest-Ruth: w1 = 1 / (2 - 2^(1/3)), w0 = 1 - 2 w1
+#define YOSHIDA4_W1 1.35120719195965763
+#define YOSHIDA4_W0 -1.70241438391931527
+
+// Yoshida (1990) sixth order, solution A; w0 = 1 - 2 (w1 + w2 + w3)
+#define YOSHIDA6_W1 -1.17767998417887
+#define YOSHIDA6_W2 0.235573213359357
+#define YOSHIDA6_W3 0.784513610477560
+#define YOSHIDA6_W0 1.31518632068391
+
+const SymplecticScheme symplecticSchemes[SYMPLECTIC_METHOD_COUNT] = {
+    [Velocity_Verlet - RK_METHOD_COUNT] = {
+        "Velocity Verlet", 1, 2,
+        { 1.0 },
+    },
+    [Yoshida4 - RK_METHOD_COUNT] = {
+        "Yoshida4", 3, 4,
+        { YOSHIDA4_W1, YOSHIDA4_W0, YOSHIDA4_W1 },
+    },
+    [Yoshida6 - RK_METHOD_COUNT] = {
+        "Yoshida6", 7, 6,
+        { YOSHIDA6_W3, YOSHIDA6_W2, YOSHIDA6_W1, YOSHIDA6_W0, YOSHIDA6_W1, YOSHIDA6_W2, YOSHIDA6_W3 },
+    },
+};
+
+void StepSymplectic(Method method, Real* positions, Real* velocities, int halfDim, Real dt,
+                    AccelerationFn acceleration, void* user, Real* accelerations, int* accelerationsValid)
+{
+    const SymplecticScheme* scheme = &symplecticSchemes[method - RK_METHOD_COUNT];
+
+    if (!*accelerationsValid) {
+        acceleration(positions, accelerations, halfDim, user);
+        *accelerationsValid = 1;
+    }
+
+    for (int s = 0; s < scheme->substeps; s++) {
+        const Real h = scheme->weights[s] * dt;
+        const Real halfH = (Real)0.5 * h;
+
+        PROFILE_BEGIN(PROFILE_STAGES);
+        for (int i = 0; i < halfDim; i++) {
+            velocities[i] += halfH * accelerations[i];
+            positions[i] += h * velocities[i];
+        }
+        PROFILE_END(PROFILE_STAGES);
+
+        acceleration(positions, accelerations, halfDim, user);
+
+        {
+            PROFILE_BEGIN(PROFILE_STAGES);
+            for (int i = 0; i < halfDim; i++) velocities[i] += halfH * accelerations[i];
+            PROFILE_END(PROFILE_STAGES);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef GABRK_SYMPLECTIC_H
+#define GABRK_SYMPLECTIC_H
+
+#include "methods.h"
+#include "precision.h"
+
+#define SYMPLECTIC_MAX_SUBSTEPS 7
+
+// Composition of velocity Verlet (kick-drift-kick) substeps of size weights[i] * dt.
+// Consecutive half kicks share one force evaluation, so a step costs one evaluation per
+// substep once the accelerations of the current positions are cached.
+typedef struct {
+    const char* name;
+    int substeps;
+    int order;
+    Real weights[SYMPLECTIC_MAX_SUBSTEPS];
+} SymplecticScheme;
+
+extern const SymplecticScheme symplecticSchemes[SYMPLECTIC_METHOD_COUNT];
+
+// Writes the accelerations of the given positions; both arrays hold halfDim values
+typedef void (*AccelerationFn)(const Real* positions, Real* accelerations, int halfDim, void* user);
+
+// positions, velocities and accelerations each hold halfDim values. accelerations must
+// hold a(positions) when *accelerationsValid is set; on return it holds a(new positions)
+// and *accelerationsValid is set.
+void StepSymplectic(Method method, Real* positions, Real* velocities, int halfDim, Real dt,
+                    AccelerationFn acceleration, void* user, Real* accelerations, int* accelerationsValid);
+
+#endif
@@ -0,0 +1,159 @@
+#include "threadpool.h"
+#include "allocator.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+typedef struct {
+    ThreadPool* pool;
+    int index;
+} Worker;
+
+struct ThreadPool {
+    int threadCount;
+    pthread_t* threads;
+    Worker* workers;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned generation;
+    int pending;
+    int stop;
+
+    ParallelFn fn;
+    void* user;
+    int count;
+};
+
+int GetCpuCount(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#endif
+}
+
+static void RunRange(ThreadPool* pool, int index)
+{
+    const int begin = (int)((long long)pool->count * index / pool->threadCount);
+    const int end = (int)((long long)pool->count * (index + 1) / pool->threadCount);
+    if (begin < end) pool->fn(begin, end, pool->user);
+}
+
+static void* WorkerMain(void* arg)
+{
+    const Worker* worker = arg;
+    ThreadPool* pool = worker->pool;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->generation == seen && !pool->stop) pthread_cond_wait(&pool->wake, &pool->mutex);
+        if (pool->stop) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        RunRange(pool, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+ThreadPool* CreateThreadPool(int threadCount)
+{
+    if (threadCount <= 0) threadCount = GetCpuCount();
+
+    ThreadPool* pool = CoreCalloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+
+    pool->threadCount = threadCount;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    if (threadCount > 1) {
+        pool->threads = CoreCalloc(threadCount - 1, sizeof(pthread_t));
+        pool->workers = CoreCalloc(threadCount - 1, sizeof(Worker));
+        if (!pool->threads || !pool->workers) {
+            pool->threadCount = 1;
+            DestroyThreadPool(pool);
+            return NULL;
+        }
+
+        // Worker i runs range i + 1; the calling thread always takes range 0
+        for (int i = 0; i < threadCount - 1; i++) {
+            pool->workers[i] = (Worker){ pool, i + 1 };
+            if (pthread_create(&pool->threads[i], NULL, WorkerMain, &pool->workers[i]) != 0) {
+                pool->threadCount = i + 1;
+                DestroyThreadPool(pool);
+                return NULL;
+            }
+        }
+    }
+
+    return pool;
+}
+
+void DestroyThreadPool(ThreadPool* pool)
+{
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->threadCount - 1; i++) pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->mutex);
+    CoreFree(pool->workers);
+    CoreFree(pool->threads);
+    CoreFree(pool);
+}
+
+int GetThreadPoolSize(const ThreadPool* pool)
+{
+    return pool ? pool->threadCount : 1;
+}
+
+void ParallelFor(ThreadPool* pool, int count, ParallelFn fn, void* user)
+{
+    if (count <= 0) return;
+
+    if (!pool || pool->threadCount == 1) {
+        fn(0, count, user);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->fn = fn;
+    pool->user = user;
+    pool->count = count;
+    pool->pending = pool->threadCount - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    RunRange(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0) pthread_cond_wait(&pool->done, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,22 @@
+#ifndef GABRK_THREADPOOL_H
+#define GABRK_THREADPOOL_H
+
+// Processes the half-open index range [begin, end)
+typedef void (*ParallelFn)(int begin, int end, void* user);
+
+typedef struct ThreadPool ThreadPool;
+
+int GetCpuCount(void);
+
+// threadCount includes the calling thread; 0 uses every online CPU. Workers are started
+// here and stay parked between jobs until DestroyThreadPool.
+ThreadPool* CreateThreadPool(int threadCount);
+void DestroyThreadPool(ThreadPool* pool);
+
+int GetThreadPoolSize(const ThreadPool* pool);
+
+// Splits [0, count) into one contiguous range per thread and blocks until all are done.
+// The split depends only on count and the pool size; a NULL pool runs fn inline.
+void ParallelFor(ThreadPool* pool, int count, ParallelFn fn, void* user);
+
+#endif
@@ -0,0 +1,54 @@
+#include "timestep.h"
+#include "clock.h"
+
+#include <math.h>
+
+FixedTimestep CreateFixedTimestep(double dt, double timeScale)
+{
+    FixedTimestep timestep = { 0 };
+    timestep.mode = TIMESTEP_REAL_TIME;
+    timestep.dt = dt;
+    timestep.timeScale = timeScale;
+    timestep.substeps = 1;
+    timestep.maxSubsteps = 1000;
+    return timestep;
+}
+
+int AdvanceFixedTimestep(FixedTimestep* timestep, double frameSeconds, TimestepStepFn step, void* user)
+{
+    int owed = 0;
+    if (timestep->mode == TIMESTEP_FIXED_SUBSTEPS) {
+        timestep->accumulator = 0.0;
+        owed = timestep->substeps;
+    }
+    else {
+        timestep->accumulator += frameSeconds * timestep->timeScale;
+        owed = (int)fmin(floor(timestep->accumulator / timestep->dt), (double)timestep->maxSubsteps);
+    }
+
+    const double start = (timestep->budgetSeconds > 0.0) ? GetClockSeconds() : 0.0;
+    int done = 0;
+    while (done < owed) {
+        step(timestep->dt, user);
+        done++;
+        timestep->steps++;
+        timestep->time += timestep->dt;
+        if (timestep->mode == TIMESTEP_REAL_TIME) timestep->accumulator -= timestep->dt;
+
+        if (timestep->budgetSeconds > 0.0 && GetClockSeconds() - start >= timestep->budgetSeconds) break;
+    }
+
+    // Keep only the fraction of a step that interpolation needs
+    if (timestep->accumulator >= timestep->dt) {
+        const double kept = fmod(timestep->accumulator, timestep->dt);
+        timestep->droppedTime += timestep->accumulator - kept;
+        timestep->accumulator = kept;
+    }
+
+    return done;
+}
+
+double GetTimestepAlpha(const FixedTimestep* timestep)
+{
+    return (timestep->mode == TIMESTEP_REAL_TIME && timestep->dt > 0.0) ? timestep->accumulator / timestep->dt : 0.0;
+}
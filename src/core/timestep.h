@@ -0,0 +1,41 @@
+#ifndef GABRK_TIMESTEP_H
+#define GABRK_TIMESTEP_H
+
+typedef enum {
+    TIMESTEP_REAL_TIME,       // Simulated time follows wall time scaled by timeScale
+    TIMESTEP_FIXED_SUBSTEPS,  // A fixed number of steps per frame, whatever the frame took
+} TimestepMode;
+
+// Fixed-timestep clock that decouples the simulation step dt from the frame rate. Each
+// frame owes some number of steps of exactly dt; what is left over (less than one step)
+// carries to the next frame and gives the alpha for interpolating the rendered state.
+typedef struct {
+    TimestepMode mode;
+    double dt;            // Simulated time per step
+    double timeScale;     // Real time: simulated time per wall-clock second
+    int substeps;         // Fixed substeps: steps per frame
+    int maxSubsteps;      // Real time: cap per frame, so one slow frame cannot snowball
+    double budgetSeconds; // Wall-clock limit on stepping per frame, 0 for none
+
+    double accumulator;   // Simulated time owed but not yet stepped
+    double time;          // Simulated time stepped so far
+    long long steps;
+    double droppedTime;   // Simulated time discarded by the caps and the budget
+} FixedTimestep;
+
+// Real-time clock with no budget and a cap of 1000 steps per frame
+FixedTimestep CreateFixedTimestep(double dt, double timeScale);
+
+// Called once per step with the timestep's dt
+typedef void (*TimestepStepFn)(double dt, void* user);
+
+// Runs the steps owed for a frame that lasted frameSeconds of wall time and returns how
+// many ran. Steps cut by maxSubsteps or the budget are dropped, not carried over, so the
+// simulation slows down instead of falling further behind every frame.
+int AdvanceFixedTimestep(FixedTimestep* timestep, double frameSeconds, TimestepStepFn step, void* user);
+
+// Fraction of a step the clock is ahead of the last step, in [0, 1): render
+// previous + (current - previous) * alpha. Always 0 with fixed substeps.
+double GetTimestepAlpha(const FixedTimestep* timestep);
+
+#endif
@@ -0,0 +1,458 @@
+#include "trajectory.h"
+#include "allocator.h"
+#include "filemap.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TRAJECTORY_MAGIC "GABRKTRJ"
+#define TRAJECTORY_VERSION 2
+#define TRAJECTORY_FRAMES_PER_BLOCK 256
+#define TRAJECTORY_BUFFER_SIZE (4 << 20)
+#define TRAJECTORY_BUFFER_COUNT 4
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t encoding;
+    uint32_t bodyCount;
+    uint32_t framesPerBlock;
+    uint64_t dataOffset;
+    uint64_t blockSize; // Of a full block
+    uint64_t frameSize;
+    double positionQuantum;
+    double velocityQuantum;
+} FileHeader;
+
+typedef struct {
+    uint64_t firstFrame;
+    uint32_t frameCount;
+    uint32_t reserved;
+} BlockHeader;
+
+typedef struct {
+    size_t dataOffset;
+    size_t keyframeSize; // Raw first frame of a quantized block, 0 for TRAJECTORY_RAW
+    size_t frameSize;
+    size_t blockSize;    // Of a full block; blocks closed early are shorter
+} Layout;
+
+static size_t AlignUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Start of frame index within its block; for index = frameCount, the size of the block
+static size_t GetFrameOffset(size_t keyframeSize, size_t frameSize, long long index)
+{
+    if (keyframeSize == 0 || index == 0) return sizeof(BlockHeader) + index * frameSize;
+    return sizeof(BlockHeader) + keyframeSize + (index - 1) * frameSize;
+}
+
+static Layout GetLayout(int bodyCount, TrajectoryEncoding encoding, int framesPerBlock)
+{
+    const size_t values = 4 * (size_t)bodyCount;
+    const size_t rawFrameSize = AlignUp(sizeof(TrajectoryFrame) + values * sizeof(float), 8);
+
+    Layout layout;
+    layout.dataOffset = AlignUp(sizeof(FileHeader) + bodyCount * sizeof(float), 64);
+    if (encoding == TRAJECTORY_QUANTIZED) {
+        layout.keyframeSize = rawFrameSize;
+        layout.frameSize = AlignUp(sizeof(TrajectoryFrame) + values * sizeof(int16_t), 8);
+    }
+    else {
+        layout.keyframeSize = 0;
+        layout.frameSize = rawFrameSize;
+    }
+    layout.blockSize = GetFrameOffset(layout.keyframeSize, layout.frameSize, framesPerBlock);
+    return layout;
+}
+
+struct TrajectoryRecorder {
+    FILE* file;
+    int bodyCount;
+    TrajectoryEncoding encoding;
+    double positionQuantum;
+    double velocityQuantum;
+    Layout layout;
+    long long frameCount;
+
+    // Blocks are encoded in place in the current buffer; full buffers go to the writer
+    unsigned char* buffers[TRAJECTORY_BUFFER_COUNT];
+    size_t used[TRAJECTORY_BUFFER_COUNT];
+    size_t bufferCapacity;
+    int current;
+    unsigned char* block; // Open block in the current buffer, NULL between blocks
+
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t submitted;
+    pthread_cond_t written;
+    int busy[TRAJECTORY_BUFFER_COUNT]; // Submitted and not yet written
+    int queueHead;
+    int queueCount;
+    int stop;
+    int failed;
+};
+
+static void* WriterMain(void* arg)
+{
+    TrajectoryRecorder* recorder = arg;
+
+    pthread_mutex_lock(&recorder->mutex);
+    for (;;) {
+        while (recorder->queueCount == 0 && !recorder->stop) pthread_cond_wait(&recorder->submitted, &recorder->mutex);
+        if (recorder->queueCount == 0) break;
+
+        // Buffers are filled round robin, so the queue is just the next few in order
+        const int index = recorder->queueHead;
+        pthread_mutex_unlock(&recorder->mutex);
+
+        const int ok = fwrite(recorder->buffers[index], 1, recorder->used[index], recorder->file) == recorder->used[index];
+
+        pthread_mutex_lock(&recorder->mutex);
+        if (!ok) recorder->failed = 1;
+        recorder->busy[index] = 0;
+        recorder->queueHead = (index + 1) % TRAJECTORY_BUFFER_COUNT;
+        recorder->queueCount--;
+        pthread_cond_signal(&recorder->written);
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+    return NULL;
+}
+
+static void SubmitBuffer(TrajectoryRecorder* recorder)
+{
+    pthread_mutex_lock(&recorder->mutex);
+    recorder->busy[recorder->current] = 1;
+    recorder->queueCount++;
+    pthread_cond_signal(&recorder->submitted);
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+// Moves to the next buffer, waiting only if the writer still has it
+static void NextBuffer(TrajectoryRecorder* recorder)
+{
+    const int next = (recorder->current + 1) % TRAJECTORY_BUFFER_COUNT;
+
+    pthread_mutex_lock(&recorder->mutex);
+    while (recorder->busy[next]) pthread_cond_wait(&recorder->written, &recorder->mutex);
+    pthread_mutex_unlock(&recorder->mutex);
+
+    recorder->current = next;
+    recorder->used[next] = 0;
+}
+
+static void OpenBlock(TrajectoryRecorder* recorder)
+{
+    const size_t blockSize = recorder->layout.blockSize;
+    if (recorder->used[recorder->current] + blockSize > recorder->bufferCapacity) {
+        SubmitBuffer(recorder);
+        NextBuffer(recorder);
+    }
+
+    unsigned char* block = recorder->buffers[recorder->current] + recorder->used[recorder->current];
+    memset(block, 0, blockSize);
+
+    const BlockHeader header = { (uint64_t)recorder->frameCount, 0, 0 };
+    memcpy(block, &header, sizeof(header));
+    recorder->block = block;
+}
+
+// The block keeps only the space of the frames it holds
+static void CloseBlock(TrajectoryRecorder* recorder)
+{
+    BlockHeader header;
+    memcpy(&header, recorder->block, sizeof(header));
+    recorder->used[recorder->current] += GetFrameOffset(recorder->layout.keyframeSize, recorder->layout.frameSize, header.frameCount);
+    recorder->block = NULL;
+}
+
+static void WriteRawFrame(const TrajectoryRecorder* recorder, unsigned char* frame, const Real* state)
+{
+    float* values = (float*)(frame + sizeof(TrajectoryFrame));
+    for (int i = 0; i < 4 * recorder->bodyCount; i++) values[i] = (float)state[i];
+}
+
+// Offsets from the block's keyframe; false if one does not fit in an int16
+static bool QuantizeFrame(const TrajectoryRecorder* recorder, const Real* state, int16_t* values)
+{
+    const float* keyframe = (const float*)(recorder->block + sizeof(BlockHeader) + sizeof(TrajectoryFrame));
+    const int positions = 2 * recorder->bodyCount;
+    bool fits = true;
+
+    for (int i = 0; i < 4 * recorder->bodyCount; i++) {
+        const double quantum = (i < positions) ? recorder->positionQuantum : recorder->velocityQuantum;
+        const double offset = nearbyint(((double)state[i] - keyframe[i]) / quantum);
+        if (!(fabs(offset) <= INT16_MAX)) {
+            fits = false;
+            values[i] = 0;
+        }
+        else {
+            values[i] = (int16_t)offset;
+        }
+    }
+    return fits;
+}
+
+TrajectoryRecorder* OpenTrajectoryRecorder(const char* path, int bodyCount, const ForceReal* mass,
+                                           TrajectoryEncoding encoding, double positionQuantum, double velocityQuantum)
+{
+    if (bodyCount <= 0) return NULL;
+    if (encoding == TRAJECTORY_QUANTIZED && !(positionQuantum > 0.0 && velocityQuantum > 0.0)) return NULL;
+
+    TrajectoryRecorder* recorder = CoreCalloc(1, sizeof(TrajectoryRecorder));
+    if (!recorder) return NULL;
+
+    recorder->bodyCount = bodyCount;
+    recorder->encoding = encoding;
+    recorder->positionQuantum = positionQuantum;
+    recorder->velocityQuantum = velocityQuantum;
+    recorder->layout = GetLayout(bodyCount, encoding, TRAJECTORY_FRAMES_PER_BLOCK);
+
+    // Room for at least one full block
+    const size_t blockSize = recorder->layout.blockSize;
+    recorder->bufferCapacity = (TRAJECTORY_BUFFER_SIZE > blockSize) ? TRAJECTORY_BUFFER_SIZE : blockSize;
+
+    int ok = 1;
+    for (int i = 0; i < TRAJECTORY_BUFFER_COUNT; i++) {
+        recorder->buffers[i] = CoreAlloc(recorder->bufferCapacity);
+        if (!recorder->buffers[i]) ok = 0;
+    }
+    recorder->file = ok ? fopen(path, "wb") : NULL;
+
+    if (recorder->file) {
+        FileHeader header = { 0 };
+        memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+        header.version = TRAJECTORY_VERSION;
+        header.encoding = (uint32_t)encoding;
+        header.bodyCount = (uint32_t)bodyCount;
+        header.framesPerBlock = TRAJECTORY_FRAMES_PER_BLOCK;
+        header.dataOffset = recorder->layout.dataOffset;
+        header.blockSize = recorder->layout.blockSize;
+        header.frameSize = recorder->layout.frameSize;
+        header.positionQuantum = positionQuantum;
+        header.velocityQuantum = velocityQuantum;
+
+        // The header and masses go into the first buffer, padded to the first block
+        unsigned char* start = recorder->buffers[0];
+        memset(start, 0, recorder->layout.dataOffset);
+        memcpy(start, &header, sizeof(header));
+        for (int i = 0; i < bodyCount; i++) {
+            const float m = (float)mass[i];
+            memcpy(start + sizeof(header) + i * sizeof(float), &m, sizeof(float));
+        }
+        ok = fwrite(start, 1, recorder->layout.dataOffset, recorder->file) == recorder->layout.dataOffset;
+    }
+
+    if (!recorder->file || !ok) {
+        if (recorder->file) fclose(recorder->file);
+        for (int i = 0; i < TRAJECTORY_BUFFER_COUNT; i++) CoreFree(recorder->buffers[i]);
+        CoreFree(recorder);
+        return NULL;
+    }
+
+    pthread_mutex_init(&recorder->mutex, NULL);
+    pthread_cond_init(&recorder->submitted, NULL);
+    pthread_cond_init(&recorder->written, NULL);
+    if (pthread_create(&recorder->writer, NULL, WriterMain, recorder) != 0) {
+        pthread_cond_destroy(&recorder->written);
+        pthread_cond_destroy(&recorder->submitted);
+        pthread_mutex_destroy(&recorder->mutex);
+        fclose(recorder->file);
+        for (int i = 0; i < TRAJECTORY_BUFFER_COUNT; i++) CoreFree(recorder->buffers[i]);
+        CoreFree(recorder);
+        return NULL;
+    }
+    return recorder;
+}
+
+void RecordTrajectoryFrame(TrajectoryRecorder* recorder, const Real* state, double time, double kineticEnergy,
+                           double potentialEnergy)
+{
+    const Layout* layout = &recorder->layout;
+    if (!recorder->block) OpenBlock(recorder);
+
+    BlockHeader header;
+    memcpy(&header, recorder->block, sizeof(header));
+    unsigned char* frame = recorder->block + GetFrameOffset(layout->keyframeSize, layout->frameSize, header.frameCount);
+
+    // The first frame of a quantized block is stored raw and is the keyframe for the rest
+    if (recorder->encoding == TRAJECTORY_QUANTIZED && header.frameCount > 0) {
+        if (!QuantizeFrame(recorder, state, (int16_t*)(frame + sizeof(TrajectoryFrame)))) {
+            // Too far from this block's keyframe: this frame becomes the next keyframe
+            CloseBlock(recorder);
+            OpenBlock(recorder);
+            memcpy(&header, recorder->block, sizeof(header));
+            frame = recorder->block + sizeof(BlockHeader);
+            WriteRawFrame(recorder, frame, state);
+        }
+    }
+    else {
+        WriteRawFrame(recorder, frame, state);
+    }
+
+    const TrajectoryFrame record = { time, kineticEnergy, potentialEnergy };
+    memcpy(frame, &record, sizeof(record));
+
+    header.frameCount++;
+    memcpy(recorder->block, &header, sizeof(header));
+    recorder->frameCount++;
+
+    if (header.frameCount == TRAJECTORY_FRAMES_PER_BLOCK) CloseBlock(recorder);
+}
+
+bool CloseTrajectoryRecorder(TrajectoryRecorder* recorder)
+{
+    if (!recorder) return false;
+
+    if (recorder->block) CloseBlock(recorder);
+    if (recorder->used[recorder->current] > 0) SubmitBuffer(recorder);
+
+    pthread_mutex_lock(&recorder->mutex);
+    recorder->stop = 1;
+    pthread_cond_signal(&recorder->submitted);
+    pthread_mutex_unlock(&recorder->mutex);
+    pthread_join(recorder->writer, NULL);
+
+    const bool closed = fclose(recorder->file) == 0;
+    const bool ok = closed && !recorder->failed;
+
+    pthread_cond_destroy(&recorder->written);
+    pthread_cond_destroy(&recorder->submitted);
+    pthread_mutex_destroy(&recorder->mutex);
+    for (int i = 0; i < TRAJECTORY_BUFFER_COUNT; i++) CoreFree(recorder->buffers[i]);
+    CoreFree(recorder);
+    return ok;
+}
+
+static BlockHeader GetBlockHeader(const Trajectory* trajectory, long long block)
+{
+    BlockHeader header;
+    memcpy(&header, trajectory->data + trajectory->blockOffsets[block], sizeof(header));
+    return header;
+}
+
+// Walks the blocks from the first one, storing each block's offset unless offsets is NULL.
+// Returns the number of whole blocks, or -1 if a block header is corrupt: frames must
+// number 1 to framesPerBlock and continue from the previous block. A block cut short by
+// the end of the file (a recording still running or interrupted) ends the walk.
+static long long IndexBlocks(const unsigned char* data, size_t size, const Layout* layout, uint32_t framesPerBlock,
+                             size_t* offsets)
+{
+    long long count = 0;
+    uint64_t nextFrame = 0;
+    size_t offset = layout->dataOffset;
+    while (size - offset >= sizeof(BlockHeader)) {
+        BlockHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        if (header.frameCount == 0 || header.frameCount > framesPerBlock || header.firstFrame != nextFrame) return -1;
+
+        const size_t blockSize = GetFrameOffset(layout->keyframeSize, layout->frameSize, header.frameCount);
+        if (blockSize > size - offset) break;
+
+        if (offsets) offsets[count] = offset;
+        offset += blockSize;
+        nextFrame += header.frameCount;
+        count++;
+    }
+    return count;
+}
+
+Trajectory LoadTrajectory(const char* path)
+{
+    Trajectory trajectory = { 0 };
+    size_t size = 0;
+    const unsigned char* data = MapFile(path, &size);
+    if (!data) return trajectory;
+
+    FileHeader header;
+    bool valid = size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, data, sizeof(header));
+        valid = memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) == 0 && header.version == TRAJECTORY_VERSION &&
+                header.encoding <= TRAJECTORY_QUANTIZED && header.bodyCount > 0 && header.bodyCount <= (1u << 26) &&
+                header.framesPerBlock > 0 && header.framesPerBlock <= (1u << 16);
+    }
+    Layout layout = { 0 };
+    if (valid) {
+        layout = GetLayout((int)header.bodyCount, (TrajectoryEncoding)header.encoding, (int)header.framesPerBlock);
+        valid = header.dataOffset == layout.dataOffset && header.blockSize == layout.blockSize &&
+                header.frameSize == layout.frameSize && size >= layout.dataOffset;
+    }
+
+    // Blocks vary in length, so their offsets are indexed once here
+    const long long blockCount = valid ? IndexBlocks(data, size, &layout, header.framesPerBlock, NULL) : -1;
+    size_t* blockOffsets = (blockCount > 0) ? CoreAlloc(blockCount * sizeof(size_t)) : NULL;
+    if (blockCount < 0 || (blockCount > 0 && !blockOffsets)) {
+        UnmapFile(data, size);
+        return trajectory;
+    }
+    IndexBlocks(data, size, &layout, header.framesPerBlock, blockOffsets);
+
+    trajectory.bodyCount = (int)header.bodyCount;
+    trajectory.encoding = (TrajectoryEncoding)header.encoding;
+    trajectory.mass = (const float*)(data + sizeof(FileHeader));
+    trajectory.data = data;
+    trajectory.size = size;
+    trajectory.blockOffsets = blockOffsets;
+    trajectory.keyframeSize = layout.keyframeSize;
+    trajectory.frameSize = header.frameSize;
+    trajectory.blockCount = blockCount;
+    trajectory.framesPerBlock = (int)header.framesPerBlock;
+    trajectory.positionQuantum = header.positionQuantum;
+    trajectory.velocityQuantum = header.velocityQuantum;
+
+    if (trajectory.blockCount > 0) {
+        const BlockHeader last = GetBlockHeader(&trajectory, trajectory.blockCount - 1);
+        trajectory.frameCount = (long long)last.firstFrame + last.frameCount;
+    }
+    return trajectory;
+}
+
+void UnloadTrajectory(Trajectory trajectory)
+{
+    if (trajectory.data) UnmapFile(trajectory.data, trajectory.size);
+    CoreFree(trajectory.blockOffsets);
+}
+
+bool GetTrajectoryFrame(const Trajectory* trajectory, long long index, TrajectoryFrame* frame, float* state)
+{
+    if (index < 0 || index >= trajectory->frameCount) return false;
+
+    // Last block starting at or before index; only the headers on the search path are touched
+    long long low = 0;
+    long long high = trajectory->blockCount - 1;
+    while (low < high) {
+        const long long middle = (low + high + 1) / 2;
+        if ((long long)GetBlockHeader(trajectory, middle).firstFrame <= index) low = middle;
+        else high = middle - 1;
+    }
+
+    const BlockHeader header = GetBlockHeader(trajectory, low);
+    const long long offset = index - (long long)header.firstFrame;
+    if (offset < 0 || offset >= header.frameCount) return false;
+
+    const unsigned char* block = trajectory->data + trajectory->blockOffsets[low];
+    const unsigned char* record = block + GetFrameOffset(trajectory->keyframeSize, trajectory->frameSize, offset);
+
+    if (frame) memcpy(frame, record, sizeof(TrajectoryFrame));
+
+    const int values = 4 * trajectory->bodyCount;
+    if (trajectory->encoding == TRAJECTORY_QUANTIZED && offset > 0) {
+        const float* keyframe = (const float*)(block + sizeof(BlockHeader) + sizeof(TrajectoryFrame));
+        const int16_t* offsets = (const int16_t*)(record + sizeof(TrajectoryFrame));
+        const int positions = 2 * trajectory->bodyCount;
+        for (int i = 0; i < values; i++) {
+            const double quantum = (i < positions) ? trajectory->positionQuantum : trajectory->velocityQuantum;
+            state[i] = (float)(keyframe[i] + offsets[i] * quantum);
+        }
+    }
+    else {
+        memcpy(state, record + sizeof(TrajectoryFrame), values * sizeof(float));
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef GABRK_TRAJECTORY_H
+#define GABRK_TRAJECTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "precision.h"
+
+// Trajectory files hold a fixed header, the masses, then blocks of up to framesPerBlock
+// frames. Every frame has its time and energies as doubles plus the state (x block, y
+// block, vx block, vy block), stored as:
+//   TRAJECTORY_RAW        floats
+//   TRAJECTORY_QUANTIZED  floats for the first frame of a block, the keyframe, then int16
+//                         offsets from it in units of the position or velocity quantum
+//                         (about half the size). A frame that does not fit starts a new
+//                         block, so a file is never much larger than with raw frames.
+// A block only takes the space of the frames it holds, and records its first frame and
+// frame count. Loading indexes the blocks, so any frame is found with a binary search
+// over the block headers. Values are stored in the host's byte order.
+typedef enum {
+    TRAJECTORY_RAW,
+    TRAJECTORY_QUANTIZED,
+} TrajectoryEncoding;
+
+typedef struct TrajectoryRecorder TrajectoryRecorder;
+
+// Frames are encoded into large buffers that a background thread writes out, so
+// recording only waits on the disk if it falls behind by several buffers. The quanta are
+// ignored for TRAJECTORY_RAW. Returns NULL if the file cannot be created.
+TrajectoryRecorder* OpenTrajectoryRecorder(const char* path, int bodyCount, const ForceReal* mass,
+                                           TrajectoryEncoding encoding, double positionQuantum, double velocityQuantum);
+
+// state is a BodySystem state: 4 * bodyCount values
+void RecordTrajectoryFrame(TrajectoryRecorder* recorder, const Real* state, double time, double kineticEnergy,
+                           double potentialEnergy);
+
+// Writes what is left and closes the file; false if any write failed
+bool CloseTrajectoryRecorder(TrajectoryRecorder* recorder);
+
+// A trajectory file mapped into memory for replay. Frames are decoded on demand.
+typedef struct {
+    int bodyCount;
+    long long frameCount;
+    TrajectoryEncoding encoding;
+    const float* mass;
+
+    // Mapping, block index and layout, for the decoder
+    const unsigned char* data;
+    size_t size;
+    size_t* blockOffsets;
+    long long blockCount;
+    size_t keyframeSize;
+    size_t frameSize;
+    int framesPerBlock;
+    double positionQuantum;
+    double velocityQuantum;
+} Trajectory;
+
+typedef struct {
+    double time;
+    double kineticEnergy;
+    double potentialEnergy;
+} TrajectoryFrame;
+
+// Returns a trajectory with bodyCount 0 if the file is missing or malformed, including any
+// corrupt block header. A file cut short (a recording still running or interrupted) loads
+// up to its last whole block.
+Trajectory LoadTrajectory(const char* path);
+void UnloadTrajectory(Trajectory trajectory);
+
+// Decodes frame index into state (4 * bodyCount floats); false if out of range
+bool GetTrajectoryFrame(const Trajectory* trajectory, long long index, TrajectoryFrame* frame, float* state);
+
+#endif
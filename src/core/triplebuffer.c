@@ -0,0 +1,31 @@
+#include "triplebuffer.h"
+
+#define TRIPLE_BUFFER_FRESH 4u
+#define TRIPLE_BUFFER_SLOT 3u
+
+void InitTripleBuffer(TripleBuffer* buffer)
+{
+    buffer->write = 0;
+    atomic_init(&buffer->middle, 1u);
+    buffer->read = 2;
+}
+
+void PublishTripleBuffer(TripleBuffer* buffer)
+{
+    // Release makes the slot's contents visible to the reader that takes it; acquire
+    // orders the reader's last use of the slot we get back before we overwrite it
+    const unsigned previous = atomic_exchange_explicit(&buffer->middle, buffer->write | TRIPLE_BUFFER_FRESH,
+                                                       memory_order_acq_rel);
+    buffer->write = previous & TRIPLE_BUFFER_SLOT;
+}
+
+unsigned AcquireTripleBuffer(TripleBuffer* buffer, bool* fresh)
+{
+    const bool changed = (atomic_load_explicit(&buffer->middle, memory_order_relaxed) & TRIPLE_BUFFER_FRESH) != 0;
+    if (changed) {
+        const unsigned previous = atomic_exchange_explicit(&buffer->middle, buffer->read, memory_order_acq_rel);
+        buffer->read = previous & TRIPLE_BUFFER_SLOT;
+    }
+    if (fresh) *fresh = changed;
+    return buffer->read;
+}
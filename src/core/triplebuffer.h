@@ -0,0 +1,27 @@
+#ifndef GABRK_TRIPLEBUFFER_H
+#define GABRK_TRIPLEBUFFER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Lock-free handoff of the latest value from one writer thread to one reader thread.
+// The caller owns three slots and the buffer only hands out their indices: the writer
+// fills its slot and publishes it, the reader takes the newest published slot. Neither
+// side ever waits, and a slot is never written while the reader holds it.
+typedef struct {
+    atomic_uint middle; // Slot in flight, with TRIPLE_BUFFER_FRESH set when not yet read
+    unsigned write;     // Owned by the writer
+    unsigned read;      // Owned by the reader
+} TripleBuffer;
+
+void InitTripleBuffer(TripleBuffer* buffer);
+
+// Writer: the slot to fill next, then publish it, which hands the writer a new slot
+static inline unsigned GetTripleBufferWriteSlot(const TripleBuffer* buffer) { return buffer->write; }
+void PublishTripleBuffer(TripleBuffer* buffer);
+
+// Reader: the newest published slot, which stays valid until the next call. fresh, if
+// not NULL, tells whether it changed since the last call.
+unsigned AcquireTripleBuffer(TripleBuffer* buffer, bool* fresh);
+
+#endif
@@ -0,0 +1,715 @@
+// Headless batch runner: integrates a BodySystem as fast as possible without a window
+// and writes energy samples and the final state to files.
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/allocator.h"
+#include "core/blockstep.h"
+#include "core/bodies.h"
+#include "core/checkpoint.h"
+#include "core/clock.h"
+#include "core/diagnostics.h"
+#include "core/pointbatch.h"
+#include "core/profiler.h"
+#include "core/rk.h"
+#include "core/scenario.h"
+#include "core/spatialsort.h"
+#include "core/threadpool.h"
+#include "core/trajectory.h"
+
+typedef struct {
+    int method;
+    double dt;
+    long steps;
+    int every;
+    int threads;
+    ForceSolver forceSolver;
+    double theta;
+    double cutoff;
+    int adaptive;
+    double rtol;
+    double atol;
+    const char* initPath;
+    const char* energyPath;
+    const char* statePath;
+    const char* recordPath;
+    int recordEvery;
+    double quantum;
+    const char* checkpointPath;
+    long checkpointEvery;
+    const char* resumePath;
+    int profile;
+    const char* tracePath;
+    const char* framePath;
+    int sortEvery;
+    SpatialOrder sortOrder;
+    int blockLevels;
+    double eta;
+    int scenario;
+    int bodies;
+    unsigned long long seed;
+    const char* writeInitPath;
+} Options;
+
+#define FRAME_WIDTH 800 // The viewer's window, so frames match what it shows
+#define FRAME_HEIGHT 600
+#define FRAME_TRAIL_LENGTH 64
+
+static void PrintUsage(const char* program)
+{
+    printf("Usage: %s [options]\n", program);
+    printf("  --method NAME     integrator name or index (default RK4)\n");
+    printf("  --dt SECONDS      time step (default 60)\n");
+    printf("  --steps N         number of steps (default 10000)\n");
+    printf("  --every N         energy and momentum sample interval in steps (default 100)\n");
+    printf("  --threads N       worker threads, 0 = all cores (default: no pool)\n");
+    printf("  --force NAME      direct | barnes-hut | cutoff (default direct)\n");
+    printf("  --theta VALUE     Barnes-Hut opening angle (default 0.5)\n");
+    printf("  --cutoff R        interaction range of the cutoff solver (default 50)\n");
+    printf("  --adaptive        use the step-size controller (embedded methods only);\n");
+    printf("                    each step then advances by dt in as many substeps as needed\n");
+    printf("  --rtol VALUE      relative tolerance (default 1e-6)\n");
+    printf("  --atol VALUE      absolute tolerance (default 1e-6)\n");
+    printf("  --block LEVELS    use fourth-order Hermite block time steps instead of --method: each\n");
+    printf("                    body steps at dt / 2^k for its own k up to LEVELS, and each step\n");
+    printf("                    still advances every body by dt (direct forces only)\n");
+    printf("  --eta VALUE       accuracy parameter of the block step criterion (default 0.02)\n");
+    printf("  --init FILE       initial conditions: a scenario saved by --write-init, or text with one\n");
+    printf("                    \"x y vx vy mass\" line per body, comma or space separated\n");
+    printf("                    (default: the viewer's two-body orbit)\n");
+    printf("  --generate NAME   generate the initial conditions instead, across --threads:\n");
+    printf("                    two-body | plummer | disk | binaries\n");
+    printf("  --bodies N        bodies to generate (default 1000)\n");
+    printf("  --seed N          seed of the generator (default 1)\n");
+    printf("  --write-init FILE save the initial conditions as a binary scenario for fast loading\n");
+    printf("  --energy FILE     write step,time,kinetic,potential,total,drift,px,py,angular,com_drift CSV\n");
+    printf("  --state FILE      write the final x,y,vx,vy,mass CSV\n");
+    printf("  --record FILE     stream the trajectory to a binary file for replay in the viewer\n");
+    printf("  --record-every N  record interval in steps (default 1)\n");
+    printf("  --quantize Q      store positions to within Q and velocities to within Q/dt: up to\n");
+    printf("                    half the size of the default float frames, and never much larger\n");
+    printf("  --checkpoint FILE write a restartable checkpoint every --checkpoint-every steps\n");
+    printf("                    and at the end, replacing FILE atomically\n");
+    printf("  --checkpoint-every N  checkpoint interval in steps (default 10000)\n");
+    printf("  --resume FILE     continue from a checkpoint up to --steps in total; the bodies, method,\n");
+    printf("                    dt, force settings, sorting and controller come from the checkpoint and\n");
+    printf("                    cannot be given again, and --energy and --record must be new files\n");
+    printf("  --profile         print time per zone and per-method step costs (needs -DGABRK_PROFILE=ON)\n");
+    printf("  --trace FILE      write a Chrome trace of every profiled zone (needs -DGABRK_PROFILE=ON)\n");
+    printf("  --frame FILE      draw the final state, with trails sampled every --every steps, into an\n");
+    printf("                    800x600 PPM image with the viewer's software renderer\n");
+    printf("  --sort-every N    reorder the bodies along a space-filling curve every N steps for cache\n");
+    printf("                    locality; output keeps the original body order (default 0, never)\n");
+    printf("  --sort-curve NAME hilbert | morton (default hilbert)\n");
+    printf("\nMethods:");
+    for (int method = 0; method < METHOD_COUNT; method++) printf("%s %s", method ? "," : "", GetMethodName(method));
+    printf("\n");
+}
+
+// Each parses the whole of text and returns 0, leaving value untouched, on anything else:
+// trailing characters, overflow or a non-finite number
+static int ParseDouble(const char* text, double* value)
+{
+    char* end = NULL;
+    errno = 0;
+    const double parsed = strtod(text, &end);
+    if (end == text || *end != '\0' || errno != 0 || !isfinite(parsed)) return 0;
+    *value = parsed;
+    return 1;
+}
+
+static int ParseLong(const char* text, long* value)
+{
+    char* end = NULL;
+    errno = 0;
+    const long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0) return 0;
+    *value = parsed;
+    return 1;
+}
+
+static int ParseInt(const char* text, int* value)
+{
+    long parsed = 0;
+    if (!ParseLong(text, &parsed) || parsed < INT_MIN || parsed > INT_MAX) return 0;
+    *value = (int)parsed;
+    return 1;
+}
+
+static int ParseSeed(const char* text, unsigned long long* value)
+{
+    char* end = NULL;
+    errno = 0;
+    const unsigned long long parsed = strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || text[0] == '-') return 0;
+    *value = parsed;
+    return 1;
+}
+
+// Options that a checkpoint restores, so --resume would ignore them
+static int IsCheckpointSetting(const char* arg)
+{
+    static const char* settings[] = { "--method", "--dt", "--adaptive", "--force", "--theta", "--cutoff", "--rtol",
+                                      "--atol", "--sort-every", "--sort-curve", "--init", "--generate", "--bodies",
+                                      "--seed", "--write-init" };
+    for (size_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++) {
+        if (strcmp(arg, settings[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int ParseOptions(int argc, char** argv, Options* options)
+{
+    const char* checkpointSetting = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!checkpointSetting && IsCheckpointSetting(arg)) checkpointSetting = arg;
+
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            PrintUsage(argv[0]);
+            exit(0);
+        }
+        if (strcmp(arg, "--adaptive") == 0) {
+            options->adaptive = 1;
+            continue;
+        }
+        if (strcmp(arg, "--profile") == 0) {
+            options->profile = 1;
+            continue;
+        }
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return 0;
+        }
+        i++;
+
+        int valid = 1;
+        if (strcmp(arg, "--method") == 0) {
+            options->method = FindMethod(value);
+            if (options->method < 0) {
+                fprintf(stderr, "Unknown method: %s\n", value);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--dt") == 0) valid = ParseDouble(value, &options->dt);
+        else if (strcmp(arg, "--steps") == 0) valid = ParseLong(value, &options->steps);
+        else if (strcmp(arg, "--every") == 0) valid = ParseInt(value, &options->every);
+        else if (strcmp(arg, "--threads") == 0) valid = ParseInt(value, &options->threads);
+        else if (strcmp(arg, "--theta") == 0) valid = ParseDouble(value, &options->theta);
+        else if (strcmp(arg, "--cutoff") == 0) valid = ParseDouble(value, &options->cutoff);
+        else if (strcmp(arg, "--rtol") == 0) valid = ParseDouble(value, &options->rtol);
+        else if (strcmp(arg, "--atol") == 0) valid = ParseDouble(value, &options->atol);
+        else if (strcmp(arg, "--block") == 0) valid = ParseInt(value, &options->blockLevels);
+        else if (strcmp(arg, "--eta") == 0) valid = ParseDouble(value, &options->eta);
+        else if (strcmp(arg, "--init") == 0) options->initPath = value;
+        else if (strcmp(arg, "--bodies") == 0) valid = ParseInt(value, &options->bodies);
+        else if (strcmp(arg, "--seed") == 0) valid = ParseSeed(value, &options->seed);
+        else if (strcmp(arg, "--write-init") == 0) options->writeInitPath = value;
+        else if (strcmp(arg, "--generate") == 0) {
+            options->scenario = FindScenarioKind(value);
+            if (options->scenario < 0) {
+                fprintf(stderr, "Unknown scenario: %s\n", value);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--energy") == 0) options->energyPath = value;
+        else if (strcmp(arg, "--state") == 0) options->statePath = value;
+        else if (strcmp(arg, "--record") == 0) options->recordPath = value;
+        else if (strcmp(arg, "--record-every") == 0) valid = ParseInt(value, &options->recordEvery);
+        else if (strcmp(arg, "--quantize") == 0) valid = ParseDouble(value, &options->quantum);
+        else if (strcmp(arg, "--checkpoint") == 0) options->checkpointPath = value;
+        else if (strcmp(arg, "--checkpoint-every") == 0) valid = ParseLong(value, &options->checkpointEvery);
+        else if (strcmp(arg, "--resume") == 0) options->resumePath = value;
+        else if (strcmp(arg, "--trace") == 0) options->tracePath = value;
+        else if (strcmp(arg, "--frame") == 0) options->framePath = value;
+        else if (strcmp(arg, "--sort-every") == 0) valid = ParseInt(value, &options->sortEvery);
+        else if (strcmp(arg, "--sort-curve") == 0) {
+            if (strcmp(value, "hilbert") == 0) options->sortOrder = SPATIAL_ORDER_HILBERT;
+            else if (strcmp(value, "morton") == 0) options->sortOrder = SPATIAL_ORDER_MORTON;
+            else {
+                fprintf(stderr, "Unknown curve: %s\n", value);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--force") == 0) {
+            if (strcmp(value, "direct") == 0) options->forceSolver = FORCE_DIRECT;
+            else if (strcmp(value, "barnes-hut") == 0) options->forceSolver = FORCE_BARNES_HUT;
+            else if (strcmp(value, "cutoff") == 0) options->forceSolver = FORCE_CUTOFF;
+            else {
+                fprintf(stderr, "Unknown force solver: %s\n", value);
+                return 0;
+            }
+        }
+        else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return 0;
+        }
+        if (!valid) {
+            fprintf(stderr, "Invalid value for %s: %s\n", arg, value);
+            return 0;
+        }
+    }
+
+    if (options->resumePath && checkpointSetting) {
+        fprintf(stderr, "%s cannot be combined with --resume, which takes it from the checkpoint\n", checkpointSetting);
+        return 0;
+    }
+    if (!(options->dt > 0.0) || options->steps < 0) {
+        fprintf(stderr, "--dt must be positive and --steps at least 0\n");
+        return 0;
+    }
+    if (options->rtol < 0.0 || options->atol < 0.0 || (options->rtol == 0.0 && options->atol == 0.0)) {
+        fprintf(stderr, "--rtol and --atol must be at least 0, and not both 0\n");
+        return 0;
+    }
+    if (options->theta < 0.0 || options->quantum < 0.0 || !(options->eta > 0.0)) {
+        fprintf(stderr, "--theta and --quantize must be at least 0 and --eta positive\n");
+        return 0;
+    }
+    if (options->bodies < 1 || options->sortEvery < 0) {
+        fprintf(stderr, "--bodies must be positive and --sort-every at least 0\n");
+        return 0;
+    }
+    if (options->every < 1) options->every = 1;
+    if (options->recordEvery < 1) options->recordEvery = 1;
+    if (options->checkpointEvery < 1) options->checkpointEvery = 10000;
+    if (options->adaptive && !IsEmbeddedMethod((Method)options->method)) {
+        fprintf(stderr, "--adaptive needs an embedded method\n");
+        return 0;
+    }
+    if (options->forceSolver == FORCE_CUTOFF && !(options->cutoff > 0.0 && isfinite(options->cutoff))) {
+        fprintf(stderr, "--cutoff must be a positive number\n");
+        return 0;
+    }
+    if (options->initPath && options->scenario >= 0) {
+        fprintf(stderr, "--init and --generate are exclusive\n");
+        return 0;
+    }
+    if (options->blockLevels > 0) {
+        // The block stepper keeps per-body caches that neither checkpoints nor sorting carry
+        if (options->adaptive || options->forceSolver != FORCE_DIRECT || options->sortEvery > 0 ||
+            options->checkpointPath || options->resumePath) {
+            fprintf(stderr, "--block cannot be combined with --adaptive, --force, --sort-every or checkpoints\n");
+            return 0;
+        }
+        if (options->blockLevels > BLOCKSTEP_MAX_LEVEL) {
+            fprintf(stderr, "--block allows at most %d levels\n", BLOCKSTEP_MAX_LEVEL);
+            return 0;
+        }
+    }
+    if ((options->profile || options->tracePath) && !IsProfilingEnabled()) {
+        fprintf(stderr, "--profile and --trace need a build configured with -DGABRK_PROFILE=ON\n");
+        return 0;
+    }
+    return 1;
+}
+
+// state and mass in the original body order (CopyBodiesById)
+static int WriteState(const char* path, const Real* state, const ForceReal* mass, int count)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) return 0;
+
+    // Enough digits to read the state back bit for bit
+    const int digits = (sizeof(Real) == sizeof(float)) ? 9 : 17;
+
+    fprintf(file, "x,y,vx,vy,mass\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%.*g,%.*g,%.*g,%.*g,%.*g\n", digits, (double)state[i], digits, (double)state[count + i],
+                digits, (double)state[2 * count + i], digits, (double)state[3 * count + i], digits, (double)mass[i]);
+    }
+
+    fclose(file);
+    return 1;
+}
+
+// Trails and the final frame, drawn the way the viewer's software fallback draws them
+typedef struct {
+    TrailBuffer trail;
+    PointBatch batch;
+    float* positions;
+    unsigned char* pixels;
+} FrameRenderer;
+
+static FrameRenderer LoadFrameRenderer(int count)
+{
+    FrameRenderer renderer = { 0 };
+    renderer.trail = LoadTrailBuffer(FRAME_TRAIL_LENGTH, count);
+    renderer.batch = LoadPointBatch(count * (1 + FRAME_TRAIL_LENGTH));
+    renderer.positions = CoreAlloc(2 * (size_t)count * sizeof(float));
+    renderer.pixels = CoreAlloc(4 * FRAME_WIDTH * FRAME_HEIGHT);
+    return renderer;
+}
+
+static void UnloadFrameRenderer(FrameRenderer renderer)
+{
+    UnloadTrailBuffer(renderer.trail);
+    UnloadPointBatch(renderer.batch);
+    CoreFree(renderer.positions);
+    CoreFree(renderer.pixels);
+}
+
+// Both take the state in the original body order, so trails and colours follow each body
+static void PushFrameTrail(FrameRenderer* renderer, const Real* state, int count)
+{
+    for (int i = 0; i < 2 * count; i++) renderer->positions[i] = (float)state[i];
+    PushTrailFrame(&renderer->trail, renderer->positions, renderer->positions + count);
+}
+
+static int WriteFrame(const char* path, FrameRenderer* renderer, const Real* state, int count)
+{
+    if (!renderer->positions || !renderer->pixels || renderer->batch.capacity == 0) return 0;
+
+    const PointColor palette[] = { { 230, 41, 55, 255 }, { 0, 121, 241, 255 }, { 80, 80, 80, 255 } }; // RED, BLUE, DARKGRAY
+    const int paletteCount = sizeof(palette) / sizeof(palette[0]);
+    const float radius = (count <= 16) ? 10.0f : 2.0f;
+
+    for (int i = 0; i < 2 * count; i++) renderer->positions[i] = (float)state[i];
+    ClearPointBatch(&renderer->batch);
+    AddTrailPoints(&renderer->batch, &renderer->trail, 0.3f * radius, palette, paletteCount, 160);
+    AddBodyPoints(&renderer->batch, renderer->positions, renderer->positions + count, count, radius,
+                  palette, paletteCount);
+
+    FillPointCanvas(renderer->pixels, FRAME_WIDTH, FRAME_HEIGHT, (PointColor){ 245, 245, 245, 255 }); // RAYWHITE
+    RasterizePointBatch(&renderer->batch, renderer->pixels, FRAME_WIDTH, FRAME_HEIGHT);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0;
+
+    fprintf(file, "P6\n%d %d\n255\n", FRAME_WIDTH, FRAME_HEIGHT);
+    for (int i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++) fwrite(renderer->pixels + 4 * i, 1, 3, file);
+    return fclose(file) == 0;
+}
+
+static void PrintProfile(void)
+{
+    ProfileSnapshot profile;
+    GetProfileSnapshot(&profile);
+
+    printf("\n%-12s %12s %12s %10s\n", "zone", "calls", "total ms", "avg us");
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        const ProfileZoneStats* stats = &profile.zones[zone];
+        if (stats->calls == 0) continue;
+        printf("%-12s %12lld %12.3f %10.3f\n", profileZoneNames[zone], stats->calls, stats->nanoseconds * 1e-6,
+               stats->nanoseconds * 1e-3 / stats->calls);
+    }
+
+    printf("\n%-24s %10s %14s %14s\n", "method", "steps", "forces/step", "ns/body-step");
+    for (int method = 0; method < METHOD_COUNT; method++) {
+        const ProfileMethodStats* stats = &profile.methods[method];
+        if (stats->steps == 0) continue;
+        printf("%-24s %10lld %14.2f %14.2f\n", GetMethodName(method), stats->steps,
+               (double)stats->forceEvaluations / stats->steps, (double)stats->nanoseconds / stats->bodySteps);
+    }
+}
+
+static int IsSampleStep(long step, long every, long lastStep)
+{
+    return step % every == 0 || step == lastStep;
+}
+
+// Everything a run owns, released in one place whether or not it got to step
+typedef struct {
+    ThreadPool* pool;
+    BodySystem system;
+    Real* orderedState; // Output always lists the bodies in their original order, whatever sorting has done
+    ForceReal* orderedMass;
+    BlockStepper blockStepper;
+    FILE* energyFile;
+    TrajectoryRecorder* recorder;
+    CheckpointWriter* checkpointWriter;
+    FrameRenderer frameRenderer;
+} Session;
+
+// A resumed run only writes the steps after its checkpoint, so it must not replace the
+// output of the run it continues
+static int RefuseExistingOutput(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+
+    fclose(file);
+    fprintf(stderr, "%s already exists; a resumed run needs a new file\n", path);
+    return 1;
+}
+
+// Loads or resumes the bodies and opens every output. On failure, reports why and
+// returns 0 with whatever was opened left for CloseSession.
+static int OpenSession(Session* session, Options* options, CheckpointRun* run)
+{
+    session->pool = (options->threads >= 0) ? CreateThreadPool(options->threads) : NULL;
+    BodySystem* system = &session->system;
+    if (options->resumePath) {
+        if (!LoadCheckpoint(options->resumePath, system, run)) {
+            fprintf(stderr, "Cannot load checkpoint %s\n", options->resumePath);
+            return 0;
+        }
+        options->method = run->method;
+        options->dt = run->dt;
+        options->adaptive = run->adaptive;
+        options->sortEvery = run->sortEvery;
+        options->sortOrder = run->sortOrder;
+
+        if ((options->energyPath && RefuseExistingOutput(options->energyPath)) ||
+            (options->recordPath && RefuseExistingOutput(options->recordPath))) {
+            return 0;
+        }
+    }
+    else {
+        if (options->initPath) {
+            *system = LoadScenario(options->initPath, session->pool);
+            if (system->count == 0) {
+                fprintf(stderr, "Cannot load initial conditions from %s\n", options->initPath);
+                return 0;
+            }
+        }
+        else {
+            const ScenarioKind kind = (options->scenario >= 0) ? (ScenarioKind)options->scenario : SCENARIO_TWO_BODY;
+            ScenarioSettings settings = CreateScenarioSettings(kind, options->bodies);
+            settings.seed = options->seed;
+            *system = GenerateScenario(&settings, session->pool);
+            if (system->count == 0) {
+                fprintf(stderr, "Cannot generate %d bodies\n", settings.count);
+                return 0;
+            }
+        }
+        if (options->writeInitPath && !WriteScenario(options->writeInitPath, system)) {
+            fprintf(stderr, "Cannot write %s\n", options->writeInitPath);
+            return 0;
+        }
+
+        system->forceSolver = options->forceSolver;
+        system->theta = (ForceReal)options->theta;
+        system->cutoff = (ForceReal)options->cutoff;
+
+        run->method = (Method)options->method;
+        run->dt = options->dt;
+        run->adaptive = options->adaptive;
+        run->sortEvery = options->sortEvery;
+        run->sortOrder = options->sortOrder;
+        run->controller = CreateAdaptiveController(options->dt, options->rtol, options->atol);
+        run->initial = ComputeDiagnostics(system);
+    }
+
+    system->pool = session->pool;
+
+    session->orderedState = CoreAlloc(GetBodySystemDim(system) * sizeof(Real));
+    session->orderedMass = CoreAlloc(system->count * sizeof(ForceReal));
+    if (!session->orderedState || !session->orderedMass) {
+        fprintf(stderr, "Cannot allocate the output buffers\n");
+        return 0;
+    }
+
+    if (options->blockLevels > 0) {
+        session->blockStepper = LoadBlockStepper(system->count, options->blockLevels, (Real)options->eta);
+        if (session->blockStepper.count == 0) {
+            fprintf(stderr, "Cannot allocate the block stepper\n");
+            return 0;
+        }
+    }
+    CopyBodiesById(system, session->orderedState, session->orderedMass);
+
+    if (options->energyPath) {
+        session->energyFile = fopen(options->energyPath, "w");
+        if (!session->energyFile) {
+            fprintf(stderr, "Cannot open %s\n", options->energyPath);
+            return 0;
+        }
+        fprintf(session->energyFile, "step,time,kinetic,potential,total,drift,px,py,angular,com_drift\n");
+    }
+
+    if (options->recordPath) {
+        const TrajectoryEncoding encoding = (options->quantum > 0.0) ? TRAJECTORY_QUANTIZED : TRAJECTORY_RAW;
+        session->recorder = OpenTrajectoryRecorder(options->recordPath, system->count, session->orderedMass, encoding,
+                                                   options->quantum, options->quantum / options->dt);
+        if (!session->recorder) {
+            fprintf(stderr, "Cannot open %s\n", options->recordPath);
+            return 0;
+        }
+    }
+
+    if (options->checkpointPath) {
+        session->checkpointWriter = CreateCheckpointWriter(options->checkpointPath, system);
+        if (!session->checkpointWriter) {
+            fprintf(stderr, "Cannot start the checkpoint writer\n");
+            return 0;
+        }
+    }
+
+    if (options->tracePath && !StartProfileTrace(1 << 20)) {
+        fprintf(stderr, "Cannot allocate the trace buffer\n");
+        return 0;
+    }
+
+    if (options->framePath) session->frameRenderer = LoadFrameRenderer(system->count);
+    return 1;
+}
+
+// Flushes and releases everything OpenSession opened; returns 0 if an output could not be written
+static int CloseSession(Session* session, const Options* options)
+{
+    int ok = 1;
+    UnloadProfileTrace();
+    if (session->energyFile) fclose(session->energyFile);
+    if (session->checkpointWriter && !CloseCheckpointWriter(session->checkpointWriter)) {
+        fprintf(stderr, "Cannot write %s\n", options->checkpointPath);
+        ok = 0;
+    }
+    if (session->recorder && !CloseTrajectoryRecorder(session->recorder)) {
+        fprintf(stderr, "Cannot write %s\n", options->recordPath);
+        ok = 0;
+    }
+    UnloadFrameRenderer(session->frameRenderer);
+    CoreFree(session->orderedState);
+    CoreFree(session->orderedMass);
+    UnloadBlockStepper(session->blockStepper);
+    session->system.pool = NULL;
+    DestroyThreadPool(session->pool);
+    UnloadBodySystem(session->system);
+    return ok;
+}
+
+// Steps the opened session to the end and writes the summary and final outputs; returns the exit status
+static int RunSession(Session* session, const Options* options, CheckpointRun* run)
+{
+    BodySystem* system = &session->system;
+    Real* orderedState = session->orderedState;
+    AdaptiveController* controller = &run->controller;
+    const Diagnostics* initial = &run->initial;
+    const long firstStep = (long)run->step;
+    double integrationSeconds = 0.0;
+
+    // A symplectic step ends with a force evaluation at its new positions; having it
+    // accumulate the potential as well makes the sample that follows O(n)
+    const int reusePotential = DIAGNOSTICS_KERNEL_POTENTIAL && IsSymplecticMethod((Method)options->method) && !options->adaptive;
+
+    for (long step = firstStep; step <= options->steps; step++) {
+        const int sampleEnergy = session->energyFile && IsSampleStep(step, options->every, options->steps);
+        const int sampleRecord = session->recorder && IsSampleStep(step, options->recordEvery, options->steps);
+        const int sampleFrame = options->framePath && IsSampleStep(step, options->every, options->steps);
+        if (sampleRecord || sampleFrame) CopyBodiesById(system, orderedState, NULL);
+        if (sampleEnergy || sampleRecord) {
+            const Diagnostics diagnostics = ComputeDiagnostics(system);
+            if (sampleEnergy) {
+                fprintf(session->energyFile, "%ld,%.9g,%.9g,%.9g,%.9g,%.6e,%.9g,%.9g,%.9g,%.6e\n", step, step * options->dt,
+                        diagnostics.kineticEnergy, diagnostics.potentialEnergy, diagnostics.totalEnergy,
+                        GetEnergyDrift(initial, &diagnostics), diagnostics.momentumX, diagnostics.momentumY,
+                        diagnostics.angularMomentum, GetCenterOfMassDrift(initial, &diagnostics, step * options->dt));
+            }
+            if (sampleRecord) {
+                RecordTrajectoryFrame(session->recorder, orderedState, step * options->dt, diagnostics.kineticEnergy,
+                                      diagnostics.potentialEnergy);
+            }
+        }
+        if (sampleFrame) PushFrameTrail(&session->frameRenderer, orderedState, system->count);
+        if (session->checkpointWriter && step > firstStep && (step % options->checkpointEvery == 0 || step == options->steps)) {
+            run->step = step;
+            RequestCheckpoint(session->checkpointWriter, system, run);
+        }
+        if (step == options->steps) break;
+
+        if (options->sortEvery > 0 && step % options->sortEvery == 0) SortBodySystem(system, options->sortOrder);
+
+        system->potentialRequested = reusePotential &&
+                                     ((session->energyFile && IsSampleStep(step + 1, options->every, options->steps)) ||
+                                      (session->recorder && IsSampleStep(step + 1, options->recordEvery, options->steps)));
+
+        const double start = GetClockSeconds();
+        if (options->blockLevels > 0) StepBodySystemBlock(system, &session->blockStepper, options->dt);
+        else if (options->adaptive) AdvanceBodySystemAdaptive(system, (Method)options->method, controller, options->dt);
+        else StepBodySystem(system, (Method)options->method, options->dt);
+        integrationSeconds += GetClockSeconds() - start;
+
+        // The first step has sized every buffer; any allocation after it is a bug
+        if (step == firstStep) LockCoreAllocations(true);
+    }
+    LockCoreAllocations(false);
+
+    const Diagnostics final = ComputeDiagnostics(system);
+    CopyBodiesById(system, orderedState, session->orderedMass);
+    const double time = options->steps * options->dt;
+    const char* methodName = (options->blockLevels > 0) ? "Hermite block steps" : GetMethodName(options->method);
+    printf("method=%s bodies=%d steps=%ld dt=%g threads=%d precision=%s\n", methodName, system->count,
+           options->steps - firstStep, options->dt, GetThreadPoolSize(session->pool), GABRK_PRECISION_NAME);
+    if (options->adaptive) printf("adaptive steps: %ld accepted, %ld rejected\n", controller->accepted, controller->rejected);
+    if (options->blockLevels > 0) {
+        // Force evaluations below then count whole-system equivalents of the block steps' body forces
+        printf("block steps=%lld body forces=%lld\n", session->blockStepper.blockSteps, session->blockStepper.bodyForces);
+        system->forceEvaluations = session->blockStepper.bodyForces / system->count;
+    }
+    printf("force evaluations=%lld allocations after warm-up=%lld\n", system->forceEvaluations, GetLockedAllocationCount());
+    if (system->forceFallbacks > 0) {
+        fprintf(stderr, "%lld force evaluations fell back to direct summation\n", system->forceFallbacks);
+    }
+    printf("steps/s=%.1f energy drift=%.6e%s\n", (options->steps - firstStep) / (integrationSeconds > 0.0 ? integrationSeconds : 1e-9),
+           GetEnergyDrift(initial, &final), (initial->totalEnergy == 0.0) ? " (absolute, initial energy is 0)" : "");
+    printf("momentum change=(%.3e, %.3e) angular momentum change=%.3e center of mass drift=%.3e\n",
+           final.momentumX - initial->momentumX, final.momentumY - initial->momentumY,
+           final.angularMomentum - initial->angularMomentum, GetCenterOfMassDrift(initial, &final, time));
+
+    if (options->profile) PrintProfile();
+
+    // The debug assert is compiled out of release builds, so fail the run here as well
+    int status = 0;
+    if (GetLockedAllocationCount() > 0) {
+        fprintf(stderr, "%lld core allocations after warm-up\n", GetLockedAllocationCount());
+        status = 1;
+    }
+    if (options->tracePath) {
+        long long dropped = 0;
+        if (!WriteProfileTrace(options->tracePath, &dropped)) {
+            fprintf(stderr, "Cannot write %s\n", options->tracePath);
+            status = 1;
+        }
+        else if (dropped > 0) {
+            fprintf(stderr, "Trace buffer full: %lld events dropped\n", dropped);
+        }
+    }
+    if (options->statePath && !WriteState(options->statePath, orderedState, session->orderedMass, system->count)) {
+        fprintf(stderr, "Cannot write %s\n", options->statePath);
+        status = 1;
+    }
+    if (options->framePath && !WriteFrame(options->framePath, &session->frameRenderer, orderedState, system->count)) {
+        fprintf(stderr, "Cannot write %s\n", options->framePath);
+        status = 1;
+    }
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    Options options = {
+        .method = RK4,
+        .dt = 60.0,
+        .steps = 10000,
+        .every = 100,
+        .threads = -1,
+        .forceSolver = FORCE_DIRECT,
+        .theta = 0.5,
+        .cutoff = 50.0,
+        .rtol = 1e-6,
+        .atol = 1e-6,
+        .recordEvery = 1,
+        .checkpointEvery = 10000,
+        .sortOrder = SPATIAL_ORDER_HILBERT,
+        .eta = 0.02,
+        .scenario = -1,
+        .bodies = 1000,
+        .seed = 1,
+    };
+    if (!ParseOptions(argc, argv, &options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    Session session = { 0 };
+    CheckpointRun run = { 0 };
+    int status = OpenSession(&session, &options, &run) ? RunSession(&session, &options, &run) : 1;
+    if (!CloseSession(&session, &options)) status = 1;
+    return status;
+}
@@ -0,0 +1,144 @@
+#include "render.h"
+
+#include <raymath.h>
+#include <rlgl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// Attribute slots for the per-instance data, clear of raylib's default mesh attributes
+#define INSTANCE_POSITION_LOCATION 6
+#define INSTANCE_COLOR_LOCATION 7
+
+// Two triangles covering [-1, 1]^2, shared by every instance
+static const float QUAD[12] = { -1, -1, 1, -1, 1, 1, -1, -1, 1, 1, -1, 1 };
+
+static const char* VERTEX_SHADER =
+    "layout(location = 0) in vec2 vertexPosition;\n"
+    "layout(location = 6) in vec3 instancePosition; // x, y, radius\n"
+    "layout(location = 7) in vec4 instanceColor;\n"
+    "uniform mat4 mvp;\n"
+    "out vec2 corner;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    corner = vertexPosition;\n"
+    "    color = instanceColor;\n"
+    "    vec2 position = instancePosition.xy + vertexPosition * max(instancePosition.z, 0.75);\n"
+    "    gl_Position = mvp * vec4(position, 0.0, 1.0);\n"
+    "}\n";
+
+static const char* FRAGMENT_SHADER =
+    "in vec2 corner;\n"
+    "in vec4 color;\n"
+    "out vec4 finalColor;\n"
+    "void main()\n"
+    "{\n"
+    "    float distance = length(corner);\n"
+    "    float coverage = 1.0 - smoothstep(1.0 - fwidth(distance), 1.0, distance);\n"
+    "    if (coverage <= 0.0) discard;\n"
+    "    finalColor = vec4(color.rgb, color.a * coverage);\n"
+    "}\n";
+
+static bool LoadInstancedPath(BodyRenderer* renderer, int capacity)
+{
+    const int version = rlGetVersion();
+    const char* header = NULL;
+    if (version == RL_OPENGL_33 || version == RL_OPENGL_43) header = "#version 330\n";
+    else if (version == RL_OPENGL_ES_30) header = "#version 300 es\nprecision mediump float;\n";
+    if (!header) return false;
+
+    char vertexCode[1024];
+    char fragmentCode[1024];
+    snprintf(vertexCode, sizeof(vertexCode), "%s%s", header, VERTEX_SHADER);
+    snprintf(fragmentCode, sizeof(fragmentCode), "%s%s", header, FRAGMENT_SHADER);
+
+    // A failed compile leaves raylib's default shader in its place
+    renderer->shader = LoadShaderFromMemory(vertexCode, fragmentCode);
+    if (renderer->shader.id == 0 || renderer->shader.id == rlGetShaderIdDefault()) return false;
+    renderer->mvpLocation = GetShaderLocation(renderer->shader, "mvp");
+
+    renderer->vertexArray = rlLoadVertexArray();
+    if (renderer->vertexArray == 0) {
+        UnloadShader(renderer->shader);
+        return false;
+    }
+    rlEnableVertexArray(renderer->vertexArray);
+
+    renderer->quadBuffer = rlLoadVertexBuffer(QUAD, sizeof(QUAD), false);
+    rlSetVertexAttribute(0, 2, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(0);
+
+    renderer->instanceBuffer = rlLoadVertexBuffer(NULL, capacity * (int)sizeof(PointInstance), true);
+    rlSetVertexAttribute(INSTANCE_POSITION_LOCATION, 3, RL_FLOAT, false, sizeof(PointInstance), 0);
+    rlEnableVertexAttribute(INSTANCE_POSITION_LOCATION);
+    rlSetVertexAttributeDivisor(INSTANCE_POSITION_LOCATION, 1);
+    rlSetVertexAttribute(INSTANCE_COLOR_LOCATION, 4, RL_UNSIGNED_BYTE, true, sizeof(PointInstance),
+                         offsetof(PointInstance, color));
+    rlEnableVertexAttribute(INSTANCE_COLOR_LOCATION);
+    rlSetVertexAttributeDivisor(INSTANCE_COLOR_LOCATION, 1);
+
+    rlDisableVertexArray();
+    return true;
+}
+
+BodyRenderer LoadBodyRenderer(int capacity)
+{
+    BodyRenderer renderer = { 0 };
+    renderer.batch = LoadPointBatch(capacity);
+
+    renderer.canvas = GenImageColor(GetScreenWidth(), GetScreenHeight(), BLANK);
+    renderer.canvasTexture = LoadTextureFromImage(renderer.canvas);
+
+    renderer.gpuAvailable = renderer.batch.capacity > 0 && LoadInstancedPath(&renderer, renderer.batch.capacity);
+    renderer.useGpu = renderer.gpuAvailable;
+    if (!renderer.gpuAvailable) TraceLog(LOG_INFO, "Instanced rendering unavailable, drawing bodies in software");
+    return renderer;
+}
+
+void UnloadBodyRenderer(BodyRenderer* renderer)
+{
+    if (renderer->gpuAvailable) {
+        rlUnloadVertexBuffer(renderer->instanceBuffer);
+        rlUnloadVertexBuffer(renderer->quadBuffer);
+        rlUnloadVertexArray(renderer->vertexArray);
+        UnloadShader(renderer->shader);
+    }
+    UnloadTexture(renderer->canvasTexture);
+    UnloadImage(renderer->canvas);
+    UnloadPointBatch(renderer->batch);
+    *renderer = (BodyRenderer){ 0 };
+}
+
+static void DrawInstanced(BodyRenderer* renderer)
+{
+    const PointBatch* batch = &renderer->batch;
+
+    // Whatever raylib has batched so far must reach the screen first
+    rlDrawRenderBatchActive();
+
+    rlUpdateVertexBuffer(renderer->instanceBuffer, batch->instances, batch->count * (int)sizeof(PointInstance), 0);
+    rlEnableShader(renderer->shader.id);
+    rlSetUniformMatrix(renderer->mvpLocation, MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection()));
+    rlEnableVertexArray(renderer->vertexArray);
+    rlDrawVertexArrayInstanced(0, 6, batch->count);
+    rlDisableVertexArray();
+    rlDisableShader();
+}
+
+static void DrawSoftware(BodyRenderer* renderer, Color background)
+{
+    Image* canvas = &renderer->canvas;
+    FillPointCanvas(canvas->data, canvas->width, canvas->height, ToPointColor(background));
+    RasterizePointBatch(&renderer->batch, canvas->data, canvas->width, canvas->height);
+    UpdateTexture(renderer->canvasTexture, canvas->data);
+    DrawTexture(renderer->canvasTexture, 0, 0, WHITE);
+}
+
+void DrawBodyRenderer(BodyRenderer* renderer, Color background)
+{
+    if (renderer->batch.count == 0) return;
+
+    if (renderer->useGpu && renderer->gpuAvailable) DrawInstanced(renderer);
+    else DrawSoftware(renderer, background);
+}
@@ -0,0 +1,40 @@
+#ifndef GABRK_RENDER_H
+#define GABRK_RENDER_H
+
+#include <raylib.h>
+#include <stdbool.h>
+
+#include "core/pointbatch.h"
+
+#define TRAIL_POINT_BUDGET (1 << 20) // Trail points across all bodies; bigger systems get fewer trail frames
+
+// Draws a PointBatch in one call. The GPU path uploads the batch as an instance buffer
+// and draws a quad per instance with a disc shader, so the cost follows fill rate rather
+// than the number of bodies. Without OpenGL 3.3 / ES 3.0 instancing, or when asked, it
+// rasterizes the batch in software into a screen-sized texture instead.
+typedef struct {
+    PointBatch batch;   // Filled by the caller each frame
+
+    bool gpuAvailable;
+    bool useGpu;
+    unsigned int vertexArray;
+    unsigned int quadBuffer;
+    unsigned int instanceBuffer;
+    Shader shader;
+    int mvpLocation;
+
+    Image canvas;       // Software path: RGBA8 pixels the size of the screen
+    Texture2D canvasTexture;
+} BodyRenderer;
+
+// Must be called after InitWindow; capacity is the most points one frame can hold
+BodyRenderer LoadBodyRenderer(int capacity);
+void UnloadBodyRenderer(BodyRenderer* renderer);
+
+// Call between BeginDrawing and EndDrawing; background is the color the software path
+// clears to, normally the ClearBackground color
+void DrawBodyRenderer(BodyRenderer* renderer, Color background);
+
+static inline PointColor ToPointColor(Color color) { return (PointColor){ color.r, color.g, color.b, color.a }; }
+
+#endif
@@ -0,0 +1,118 @@
+#include "replay.h"
+
+#include <raylib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/trajectory.h"
+#include "render.h"
+
+static const float TIMELINE_HEIGHT = 12.0f;
+static const int MAX_TRAIL_FRAMES = 64;
+
+int RunReplay(const char* path)
+{
+    Trajectory trajectory = LoadTrajectory(path);
+    if (trajectory.bodyCount == 0 || trajectory.frameCount == 0) {
+        fprintf(stderr, "Cannot load trajectory %s\n", path);
+        UnloadTrajectory(trajectory);
+        return 1;
+    }
+
+    const int count = trajectory.bodyCount;
+    float* state = malloc(4 * count * sizeof(float));
+    if (!state) return 1;
+
+    TrajectoryFrame first;
+    GetTrajectoryFrame(&trajectory, 0, &first, state);
+    const double initialEnergy = first.kineticEnergy + first.potentialEnergy;
+
+    InitWindow(800, 600, "GABRK replay");
+    SetTargetFPS(60);
+
+    int trailFrames = TRAIL_POINT_BUDGET / count;
+    if (trailFrames > MAX_TRAIL_FRAMES) trailFrames = MAX_TRAIL_FRAMES;
+
+    const PointColor palette[] = { ToPointColor(RED), ToPointColor(BLUE), ToPointColor(DARKGRAY) };
+    const int paletteCount = sizeof(palette) / sizeof(palette[0]);
+    BodyRenderer renderer = LoadBodyRenderer(count * (1 + trailFrames));
+    TrailBuffer trail = LoadTrailBuffer(trailFrames, count);
+    bool showTrails = true;
+    long long trailIndex = -1; // Last frame pushed to the trail
+
+    const long long lastFrame = trajectory.frameCount - 1;
+    double position = 0.0;  // Fractional frame, so slow speeds still advance
+    double speed = 60.0;    // Frames per second
+    bool playing = true;
+
+    while (!WindowShouldClose())
+    {
+        if (IsKeyPressed(KEY_SPACE)) playing = !playing;
+        if (IsKeyPressed(KEY_L)) showTrails = !showTrails;
+        if (IsKeyPressed(KEY_V)) renderer.useGpu = !renderer.useGpu;
+        if (IsKeyPressed(KEY_UP) && speed < 1e7) speed *= 2.0;
+        if (IsKeyPressed(KEY_DOWN) && speed > 1.0) speed *= 0.5;
+        if (IsKeyPressed(KEY_HOME)) position = 0.0;
+        if (IsKeyPressed(KEY_END)) position = (double)lastFrame;
+        if (IsKeyPressed(KEY_RIGHT) || IsKeyPressed(KEY_LEFT)) {
+            playing = false;
+            position = (double)(long long)position + (IsKeyPressed(KEY_RIGHT) ? 1.0 : -1.0);
+        }
+
+        // Click or drag on the timeline to jump anywhere; decoding a frame is one block lookup
+        const float timelineY = GetScreenHeight() - TIMELINE_HEIGHT;
+        if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && GetMousePosition().y >= timelineY) {
+            position = (double)GetMousePosition().x / GetScreenWidth() * lastFrame;
+        }
+
+        if (playing) position += speed * GetFrameTime();
+        if (position < 0.0) position = 0.0;
+        if (position > (double)lastFrame) {
+            position = (double)lastFrame;
+            playing = false;
+        }
+
+        const long long index = (long long)position;
+        TrajectoryFrame frame;
+        GetTrajectoryFrame(&trajectory, index, &frame, state);
+        const double totalEnergy = frame.kineticEnergy + frame.potentialEnergy;
+
+        BeginDrawing();
+        ClearBackground(RAYWHITE);
+
+        // Trails follow playback frame by frame; a seek starts them afresh
+        if (index != trailIndex) {
+            if (index != trailIndex + 1) ClearTrailBuffer(&trail);
+            PushTrailFrame(&trail, state, state + count);
+            trailIndex = index;
+        }
+
+        const float radius = (count <= 16) ? 10.0f : 2.0f;
+        ClearPointBatch(&renderer.batch);
+        if (showTrails) AddTrailPoints(&renderer.batch, &trail, 0.3f * radius, palette, paletteCount, 160);
+        AddBodyPoints(&renderer.batch, state, state + count, count, radius, palette, paletteCount);
+        DrawBodyRenderer(&renderer, RAYWHITE);
+
+        DrawText(TextFormat("Frame %lld / %lld, time %.0f (%s, %.0f frames/s)", index, lastFrame, frame.time,
+                            playing ? "playing" : "paused", speed), 10, 10, 20, BLACK);
+        DrawText(TextFormat("Kinetic Energy: %.3f", frame.kineticEnergy), 10, 80, 20, BLACK);
+        DrawText(TextFormat("Potential Energy: %.3f", frame.potentialEnergy), 10, 110, 20, BLACK);
+        DrawText(TextFormat("Total Energy: %.3f (drift %.3e)", totalEnergy,
+                            (initialEnergy != 0.0) ? (totalEnergy - initialEnergy) / initialEnergy : 0.0), 10, 140, 20, BLACK);
+
+        DrawRectangle(0, (int)timelineY, GetScreenWidth(), (int)TIMELINE_HEIGHT, LIGHTGRAY);
+        DrawRectangle(0, (int)timelineY, (int)(GetScreenWidth() * (lastFrame ? position / lastFrame : 1.0)), (int)TIMELINE_HEIGHT, GRAY);
+
+        DrawText("SPACE play/pause, LEFT/RIGHT step, UP/DOWN speed, click timeline to seek", 10, GetScreenHeight() - 55, 20, BLACK);
+        DrawText(TextFormat("L trails, V renderer (%s), ESC to quit",
+                            (renderer.useGpu && renderer.gpuAvailable) ? "instanced" : "software"), 10, GetScreenHeight() - 35, 20, BLACK);
+        EndDrawing();
+    }
+
+    UnloadTrailBuffer(trail);
+    UnloadBodyRenderer(&renderer);
+    CloseWindow();
+    free(state);
+    UnloadTrajectory(trajectory);
+    return 0;
+}
@@ -0,0 +1,7 @@
+#ifndef GABRK_REPLAY_H
+#define GABRK_REPLAY_H
+
+// Plays back a trajectory file written by gabrk_headless --record; returns the exit code
+int RunReplay(const char* path);
+
+#endif
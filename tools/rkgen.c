@@ -0,0 +1,357 @@
+// Build-time generator for the Runge-Kutta methods (see src/core/rk_tableaus.def):
+//
+//   rkgen rk_tableaus.def rk_methods.inc rk_kernels.inc
+//
+// rk_methods.inc lists the Method enumerators. rk_kernels.inc defines rkTableaus and one
+// stepper per method with the stage loop unrolled, every coefficient a constant, zero
+// terms dropped and stages that feed nothing left out, plus the steppers table of rk.c.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_METHODS 64
+#define MAX_STAGES 16
+#define MAX_TEXT 64
+
+// A coefficient as the C expression written out (empty for zero) and its value
+typedef struct {
+    char text[MAX_TEXT];
+    double value;
+} Coefficient;
+
+typedef struct {
+    char id[MAX_TEXT];
+    char name[MAX_TEXT];
+    int line;
+    int order;
+    int embeddedOrder;
+    int fsal;
+    int stages;     // Number of b entries
+    int rows;       // Rows of a given, after the implicit first one
+    int cCount;
+    int bHatCount;
+    Coefficient a[MAX_STAGES][MAX_STAGES];
+    Coefficient b[MAX_STAGES];
+    Coefficient bHat[MAX_STAGES];
+    Coefficient c[MAX_STAGES];
+} Tableau;
+
+static const char* inputPath;
+
+static int Fail(int line, const char* message, const char* detail)
+{
+    fprintf(stderr, "%s:%d: %s%s%s\n", inputPath, line, message, detail ? ": " : "", detail ? detail : "");
+    return 0;
+}
+
+// Integers gain ".0" so every expression is evaluated in double, as the handwritten table was
+static int WriteNumber(char* out, size_t size, const char* number, double* value)
+{
+    char* end = NULL;
+    *value = strtod(number, &end);
+    if (end == number || *end != '\0') return 0;
+
+    const int integer = strpbrk(number, ".eE") == NULL;
+    return snprintf(out, size, "%s%s", number, integer ? ".0" : "") < (int)size;
+}
+
+// Decimals such as -0.2 or fractions such as -7200/2197
+static int ParseCoefficient(const char* token, Coefficient* coefficient, int line)
+{
+    char numerator[MAX_TEXT];
+    char left[MAX_TEXT / 2 - 2]; // Both halves and " / " fit the text
+    char right[MAX_TEXT / 2 - 2];
+    const char* slash = strchr(token, '/');
+    double value = 0.0;
+
+    if (strlen(token) >= MAX_TEXT) return Fail(line, "coefficient too long", token);
+
+    if (slash) {
+        double denominator = 0.0;
+        memcpy(numerator, token, slash - token);
+        numerator[slash - token] = '\0';
+        if (!WriteNumber(left, sizeof(left), numerator, &value) || !WriteNumber(right, sizeof(right), slash + 1, &denominator) ||
+            denominator == 0.0) {
+            return Fail(line, "bad fraction", token);
+        }
+        value /= denominator;
+        snprintf(coefficient->text, sizeof(coefficient->text), "%s / %s", left, right);
+    }
+    else if (!WriteNumber(coefficient->text, sizeof(coefficient->text), token, &value)) {
+        return Fail(line, "bad coefficient", token);
+    }
+
+    coefficient->value = value;
+    if (value == 0.0) coefficient->text[0] = '\0';
+    return 1;
+}
+
+// Reads the coefficients after the keyword of a row into out; returns how many, -1 on error
+static int ParseRow(char* rest, Coefficient* out, int max, int line)
+{
+    int count = 0;
+    for (char* token = strtok(rest, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        if (count == max) {
+            Fail(line, "too many coefficients", NULL);
+            return -1;
+        }
+        if (!ParseCoefficient(token, &out[count++], line)) return -1;
+    }
+    return count;
+}
+
+static int ParseMethod(char* rest, Tableau* tableau, int line)
+{
+    char* quote = strchr(rest, '"');
+    char* closing = quote ? strchr(quote + 1, '"') : NULL;
+    if (!closing || sscanf(rest, "%63s", tableau->id) != 1) return Fail(line, "expected: method ID \"Name\" order N", NULL);
+
+    const size_t length = closing - quote - 1;
+    if (length >= MAX_TEXT) return Fail(line, "name too long", NULL);
+    memcpy(tableau->name, quote + 1, length);
+    tableau->name[length] = '\0';
+    tableau->line = line;
+
+    for (char* token = strtok(closing + 1, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        if (strcmp(token, "fsal") == 0) {
+            tableau->fsal = 1;
+            continue;
+        }
+
+        const char* value = strtok(NULL, " \t\r\n");
+        if (!value) return Fail(line, "missing value for", token);
+        if (strcmp(token, "order") == 0) tableau->order = atoi(value);
+        else if (strcmp(token, "embedded") == 0) tableau->embeddedOrder = atoi(value);
+        else return Fail(line, "unknown method attribute", token);
+    }
+    return tableau->order > 0 ? 1 : Fail(line, "missing order", NULL);
+}
+
+static int ParseTableaus(FILE* file, Tableau* tableaus, int* count)
+{
+    char buffer[1024];
+    Tableau* tableau = NULL;
+
+    for (int line = 1; fgets(buffer, sizeof(buffer), file); line++) {
+        char keyword[16];
+        int offset = 0;
+        if (buffer[0] == '#' || sscanf(buffer, "%15s%n", keyword, &offset) != 1) continue;
+        char* rest = buffer + offset;
+
+        if (strcmp(keyword, "method") == 0) {
+            if (*count == MAX_METHODS) return Fail(line, "too many methods", NULL);
+            tableau = &tableaus[(*count)++];
+            if (!ParseMethod(rest, tableau, line)) return 0;
+            continue;
+        }
+        if (!tableau) return Fail(line, "coefficients before the first method", NULL);
+
+        if (strcmp(keyword, "a") == 0) {
+            const int row = ++tableau->rows;
+            if (row >= MAX_STAGES) return Fail(line, "too many rows", NULL);
+            const int entries = ParseRow(rest, tableau->a[row], row, line);
+            if (entries < 0) return 0;
+        }
+        else if (strcmp(keyword, "b") == 0) {
+            if ((tableau->stages = ParseRow(rest, tableau->b, MAX_STAGES, line)) <= 0) return 0;
+        }
+        else if (strcmp(keyword, "bhat") == 0) {
+            if ((tableau->bHatCount = ParseRow(rest, tableau->bHat, MAX_STAGES, line)) <= 0) return 0;
+        }
+        else if (strcmp(keyword, "c") == 0) {
+            if ((tableau->cCount = ParseRow(rest, tableau->c, MAX_STAGES, line)) <= 0) return 0;
+        }
+        else {
+            return Fail(line, "unknown keyword", keyword);
+        }
+    }
+    return 1;
+}
+
+// Catches typos in the data: the rows must sum to c (so stages are evaluated at the
+// right times), the weights to one, and an FSAL last stage must be the new state
+static int ValidateTableau(const Tableau* tableau)
+{
+    const double tolerance = 1e-12;
+    const int line = tableau->line;
+    const int stages = tableau->stages;
+
+    if (stages == 0) return Fail(line, "no b weights for", tableau->id);
+    if (tableau->rows != stages - 1) return Fail(line, "need one a row per stage after the first for", tableau->id);
+    if (tableau->cCount != 0 && tableau->cCount != stages) return Fail(line, "c needs one node per stage for", tableau->id);
+    if ((tableau->embeddedOrder > 0) != (tableau->bHatCount > 0)) return Fail(line, "embedded order and bhat go together for", tableau->id);
+    if (tableau->bHatCount != 0 && tableau->bHatCount != stages) return Fail(line, "bhat needs one weight per stage for", tableau->id);
+
+    double bSum = 0.0, bHatSum = 0.0;
+    for (int s = 0; s < stages; s++) {
+        double rowSum = 0.0;
+        for (int j = 0; j < s; j++) rowSum += tableau->a[s][j].value;
+        if (fabs(rowSum - tableau->c[s].value) > tolerance) return Fail(line, "an a row does not sum to its c node in", tableau->id);
+        bSum += tableau->b[s].value;
+        bHatSum += tableau->bHat[s].value;
+    }
+    if (fabs(bSum - 1.0) > tolerance) return Fail(line, "b does not sum to 1 in", tableau->id);
+    if (tableau->bHatCount && fabs(bHatSum - 1.0) > tolerance) return Fail(line, "bhat does not sum to 1 in", tableau->id);
+
+    if (tableau->fsal) {
+        for (int j = 0; j < stages; j++) {
+            const double last = (j < stages - 1) ? tableau->a[stages - 1][j].value : 0.0;
+            if (last != tableau->b[j].value) return Fail(line, "fsal needs the last a row to equal b in", tableau->id);
+        }
+    }
+    return 1;
+}
+
+static void WriteCoefficients(FILE* out, const Coefficient* coefficients, int count)
+{
+    fprintf(out, "{ ");
+    for (int i = 0; i < count; i++) fprintf(out, "%s%s", i ? ", " : "", coefficients[i].text[0] ? coefficients[i].text : "0.0");
+    fprintf(out, " }");
+}
+
+static void WriteTableau(FILE* out, const Tableau* tableau)
+{
+    fprintf(out, "    [%s] = {\n", tableau->id);
+    fprintf(out, "        \"%s\", %d, %d, .embeddedOrder = %d, .fsal = %d,\n", tableau->name, tableau->stages,
+            tableau->order, tableau->embeddedOrder, tableau->fsal);
+    fprintf(out, "        .a = {\n            { 0 },\n");
+    for (int s = 1; s < tableau->stages; s++) {
+        fprintf(out, "            ");
+        WriteCoefficients(out, tableau->a[s], s);
+        fprintf(out, ",\n");
+    }
+    fprintf(out, "        },\n        .b = ");
+    WriteCoefficients(out, tableau->b, tableau->stages);
+    if (tableau->bHatCount) {
+        fprintf(out, ",\n        .bHat = ");
+        WriteCoefficients(out, tableau->bHat, tableau->stages);
+    }
+    fprintf(out, ",\n        .c = ");
+    WriteCoefficients(out, tableau->c, tableau->stages);
+    fprintf(out, ",\n    },\n");
+}
+
+// Writes one fused loop: out[i] = base[i] + h0 * k0[i] + ... over the nonzero weights.
+// The sum runs in stage order, so rounding matches adding the terms one at a time.
+static void WriteCombination(FILE* out, const char* target, const char* base, const Coefficient* weights, int count,
+                             const char* prefix)
+{
+    fprintf(out, "    {\n        PROFILE_BEGIN(PROFILE_STAGES);\n");
+    for (int j = 0; j < count; j++) {
+        if (weights[j].text[0]) fprintf(out, "        const Real %s%d = dt * (Real)(%s);\n", prefix, j, weights[j].text);
+    }
+    fprintf(out, "        for (int i = 0; i < dim; i++) %s[i] = %s[i]", target, base);
+    for (int j = 0; j < count; j++) {
+        if (weights[j].text[0]) fprintf(out, " + %s%d * k%d[i]", prefix, j, j);
+    }
+    fprintf(out, ";\n        PROFILE_END(PROFILE_STAGES);\n    }\n");
+}
+
+static void WriteStepper(FILE* out, const Tableau* tableau)
+{
+    const int stages = tableau->stages;
+
+    // A stage is needed if its derivative is weighted into the result or feeds a needed stage
+    int needed[MAX_STAGES] = { 0 };
+    for (int s = stages - 1; s >= 0; s--) {
+        needed[s] = tableau->b[s].text[0] != '\0';
+        for (int t = s + 1; t < stages; t++) needed[s] |= needed[t] && tableau->a[t][s].text[0];
+    }
+
+    // Stages with an all-zero row are evaluated at the state itself and need no stage input
+    int combined[MAX_STAGES] = { 0 };
+    int anyCombined = 0;
+    for (int s = 0; s < stages; s++) {
+        for (int j = 0; j < s; j++) combined[s] |= tableau->a[s][j].text[0] != '\0';
+        anyCombined |= needed[s] && combined[s];
+    }
+
+    const int indent = (int)strlen("static void Step_(") + (int)strlen(tableau->id);
+    fprintf(out, "\nstatic void Step_%s(Real* restrict state, int dim, Real dt, DerivativeFn derivative, void* user,\n", tableau->id);
+    fprintf(out, "%*sReal* restrict scratch)\n{\n", indent, "");
+    if (anyCombined) fprintf(out, "    Real* restrict stage = scratch;\n");
+    for (int s = 0; s < stages; s++) {
+        if (needed[s]) fprintf(out, "    Real* restrict k%d = scratch + %d * dim;\n", s, s + 1);
+    }
+    fprintf(out, "\n");
+
+    for (int s = 0; s < stages; s++) {
+        if (!needed[s]) continue;
+
+        if (!combined[s]) {
+            fprintf(out, "    derivative(state, k%d, dim, user);\n", s);
+            continue;
+        }
+        WriteCombination(out, "stage", "state", tableau->a[s], s, "a");
+        fprintf(out, "    derivative(stage, k%d, dim, user);\n", s);
+    }
+
+    fprintf(out, "\n");
+    WriteCombination(out, "state", "state", tableau->b, stages, "b");
+    fprintf(out, "}\n");
+}
+
+static int WriteMethods(const char* path, const Tableau* tableaus, int count)
+{
+    FILE* out = fopen(path, "w");
+    if (!out) return 0;
+
+    fprintf(out, "// Generated by tools/rkgen.c from src/core/rk_tableaus.def; included inside the Method enum\n");
+    for (int m = 0; m < count; m++) fprintf(out, "    %s,\n", tableaus[m].id);
+    return fclose(out) == 0;
+}
+
+static int WriteKernels(const char* path, const Tableau* tableaus, int count)
+{
+    FILE* out = fopen(path, "w");
+    if (!out) return 0;
+
+    int maxStages = 0;
+    for (int m = 0; m < count; m++) maxStages = (tableaus[m].stages > maxStages) ? tableaus[m].stages : maxStages;
+
+    fprintf(out, "// Generated by tools/rkgen.c from src/core/rk_tableaus.def; included by rk.c\n\n");
+    fprintf(out, "_Static_assert(RK_MAX_STAGES >= %d, \"rk_tableaus.def has more stages than RK_MAX_STAGES\");\n\n", maxStages);
+
+    fprintf(out, "const ButcherTableau rkTableaus[RK_METHOD_COUNT] = {\n");
+    for (int m = 0; m < count; m++) WriteTableau(out, &tableaus[m]);
+    fprintf(out, "};\n");
+
+    for (int m = 0; m < count; m++) WriteStepper(out, &tableaus[m]);
+
+    fprintf(out, "\nstatic const StepFn steppers[RK_METHOD_COUNT] = {\n");
+    for (int m = 0; m < count; m++) fprintf(out, "    [%s] = Step_%s,\n", tableaus[m].id, tableaus[m].id);
+    fprintf(out, "};\n");
+    return fclose(out) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s rk_tableaus.def rk_methods.inc rk_kernels.inc\n", argv[0]);
+        return 1;
+    }
+    inputPath = argv[1];
+
+    FILE* file = fopen(inputPath, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", inputPath);
+        return 1;
+    }
+
+    static Tableau tableaus[MAX_METHODS];
+    int count = 0;
+    const int parsed = ParseTableaus(file, tableaus, &count);
+    fclose(file);
+    if (!parsed) return 1;
+
+    for (int m = 0; m < count; m++) {
+        if (!ValidateTableau(&tableaus[m])) return 1;
+    }
+
+    if (!WriteMethods(argv[2], tableaus, count) || !WriteKernels(argv[3], tableaus, count)) {
+        fprintf(stderr, "Cannot write the generated files\n");
+        return 1;
+    }
+    return 0;
+}